@@ -43,6 +43,12 @@ public:
 
   bool intersect(const Ray& ray, Interaction& isect) const override;
 
+  // Traces the stream in packets of up to 64 rays that walk the tree
+  // together, each node being fetched once for every ray of the packet
+  // that reaches it. Pays off for coherent rays such as those sharing an
+  // origin.
+  void occludedStream(const Ray* rays, int n, bool* occluded) const override;
+
 private:
   BVHNode* createLeafNode(
     std::vector<PrimInfo>& primInfos,
@@ -96,6 +102,8 @@ private:
 
   void flattenBVHTree(const BVHNode* node);
 
+  void occludedPacket(const Ray* rays, int n, bool* occluded) const;
+
 private:
   std::vector<Triangle> triangles;
   std::vector<LinearBVHNode> nodes;
@@ -15,6 +15,10 @@ public:
     return Spectrum(kd) * InvPi;
   }
 
+  Spectrum albedo() const override {
+    return kd;
+  }
+
 public:
   Spectrum kd;
 };
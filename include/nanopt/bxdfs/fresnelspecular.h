@@ -15,6 +15,11 @@ public:
     return true;
   }
 
+  Spectrum albedo() const override {
+    auto f = frDielectric(1, eta);
+    return kr * f + kt * (1 - f);
+  }
+
   float pdf(const Vector3f& wo, const Vector3f& wi) const override {
     return 0;
   }
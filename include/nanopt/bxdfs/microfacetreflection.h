@@ -15,9 +15,8 @@ public:
   ) noexcept : ks(ks), fresnel(fresnel), distribution(distribution)
   { }
 
-  ~MicrofacetReflection() {
-    delete fresnel;
-    delete distribution;
+  Spectrum albedo() const override {
+    return ks;
   }
 
   float pdf(const Vector3f& wo, const Vector3f& wi) const override {
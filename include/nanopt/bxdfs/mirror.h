@@ -13,6 +13,10 @@ public:
     return true;
   }
 
+  Spectrum albedo() const override {
+    return kr;
+  }
+
   float pdf(const Vector3f& wo, const Vector3f& wi) const override {
     return 0;
   }
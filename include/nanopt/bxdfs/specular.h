@@ -11,14 +11,14 @@ public:
     : fresnel(fresnel), kr(kr)
   { }
 
-  ~SpecularReflection() {
-    delete fresnel;
-  }
-
   bool isDelta() const override {
     return true;
   }
 
+  Spectrum albedo() const override {
+    return kr;
+  }
+
   float pdf(const Vector3f& wo, const Vector3f& wi) const override {
     return 0;
   }
@@ -13,8 +13,16 @@ public:
       : ProjectiveCamera(
         frame, film,
         Matrix4::perspective(fov, 0.01f, 1000.0f),
-        screenWindow)
-  { }
+        screenWindow) {
+
+    worldToCamera = inverse(frame);
+    cameraToRaster = inverse(rasterToCamera);
+    auto pMin = rasterToCamera.applyP(Vector3f(0));
+    auto pMax = rasterToCamera.applyP(Vector3f((float)film.resolution.x, (float)film.resolution.y, 0));
+    pMin = pMin / pMin.z;
+    pMax = pMax / pMax.z;
+    filmArea = std::abs((pMax.x - pMin.x) * (pMax.y - pMin.y));
+  }
 
   Ray generateRay(const CameraSample& sample) const override {
     Vector3f pFilm(sample.pFilm);
@@ -22,6 +30,63 @@ public:
     Ray ray(Vector3f(0), normalize(pCamera));
     return frame(ray);
   }
+
+  Spectrum we(const Ray& ray, Vector2f* pRaster = nullptr) const override {
+    float cosTheta;
+    if (!toRaster(ray, cosTheta, pRaster)) return Spectrum(0);
+    auto cos2Theta = cosTheta * cosTheta;
+    return Spectrum(1 / (filmArea * cos2Theta * cos2Theta));
+  }
+
+  void pdfWe(const Ray& ray, float& pdfPos, float& pdfDir) const override {
+    float cosTheta;
+    if (!toRaster(ray, cosTheta, nullptr)) {
+      pdfPos = pdfDir = 0;
+      return;
+    }
+    pdfPos = 1;
+    pdfDir = 1 / (filmArea * cosTheta * cosTheta * cosTheta);
+  }
+
+  Spectrum sampleWi(
+    const Interaction& ref,
+    const Vector2f& u,
+    Vector3f& wi, float& pdf,
+    Vector2f& pRaster, VisibilityTester& tester) const override {
+
+    auto pCamera = frame.applyP(Vector3f(0));
+    wi = pCamera - ref.p;
+    auto distance2 = wi.lengthSquared();
+    wi = wi / std::sqrt(distance2);
+    auto forward = normalize(frame.applyV(Vector3f(0, 0, 1)));
+    auto cosTheta = absdot(forward, wi);
+    if (cosTheta == 0) {
+      pdf = 0;
+      return Spectrum(0);
+    }
+    pdf = distance2 / cosTheta;
+    tester = VisibilityTester(ref, pCamera);
+    return we(Ray(pCamera, -wi), &pRaster);
+  }
+
+private:
+  // Maps a ray from the camera to the film, false when it misses it.
+  bool toRaster(const Ray& ray, float& cosTheta, Vector2f* pRaster) const {
+    auto d = normalize(worldToCamera.applyV(ray.d));
+    cosTheta = d.z;
+    if (cosTheta <= 0) return false;
+    auto p = cameraToRaster.applyP(d / d.z);
+    if (p.x < 0 || p.x >= film.resolution.x || p.y < 0 || p.y >= film.resolution.y)
+      return false;
+    if (pRaster) *pRaster = Vector2f(p.x, p.y);
+    return true;
+  }
+
+private:
+  Matrix4 worldToCamera;
+  Matrix4 cameraToRaster;
+  // Area of the film on the plane at unit distance in front of the camera.
+  float filmArea;
 };
 
 inline Bounds2f defaultScreenBounds(float aspectRatio) {
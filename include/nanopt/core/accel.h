@@ -12,6 +12,18 @@ public:
   virtual Bounds3f getBounds() const = 0;
   virtual bool intersect(const Ray& ray) const = 0;
   virtual bool intersect(const Ray& ray, Interaction& isect) const = 0;
+
+  // Batched queries for wavefront integrators. The defaults answer one ray
+  // at a time, accelerators can override them to traverse a whole stream.
+  virtual void intersectStream(const Ray* rays, int n, Interaction* isects, bool* hits) const {
+    for (auto i = 0; i < n; ++i)
+      hits[i] = intersect(rays[i], isects[i]);
+  }
+
+  virtual void occludedStream(const Ray* rays, int n, bool* occluded) const {
+    for (auto i = 0; i < n; ++i)
+      occluded[i] = intersect(rays[i]);
+  }
 };
 
 }
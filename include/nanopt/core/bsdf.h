@@ -2,6 +2,7 @@
 
 #include <nanopt/core/bxdf.h>
 #include <nanopt/core/frame.h>
+#include <nanopt/core/stats.h>
 #include <nanopt/core/spectrum.h>
 #include <nanopt/core/interaction.h>
 
@@ -12,11 +13,6 @@ public:
   BSDF(const Interaction& isect) noexcept : nBxDFs(0), shFrame(isect.ns)
   { }
 
-  ~BSDF() noexcept {
-    for (auto i = 0; i < nBxDFs; ++i)
-      delete bxdfs[i];
-  }
-
   bool isDelta() const {
     if (nBxDFs == 1 && bxdfs[0]->isDelta())
       return true;
@@ -51,7 +47,8 @@ public:
     float& pdf,
     float& etaScale) const {
 
-    auto n = std::min((int)u[0] * nBxDFs, nBxDFs - 1);
+    NANOPT_STAT_INC(BSDFSamples);
+    auto n = std::min((int)(u[0] * nBxDFs), nBxDFs - 1);
     auto uRemapped = Vector2f(u[0] * nBxDFs - n, u[1]);
     auto wo = toLocal(woWorld);
     Vector3f wi;
@@ -73,6 +70,13 @@ public:
     return f;
   }
 
+  Spectrum albedo() const {
+    Spectrum albedo(0);
+    for (auto i = 0; i < nBxDFs; ++i)
+      albedo += bxdfs[i]->albedo();
+    return albedo;
+  }
+
   float pdf(const Vector3f& woWorld, const Vector3f& wiWorld) const {
     auto wo = toLocal(woWorld);
     auto wi = toLocal(wiWorld);
@@ -89,4 +93,12 @@ private:
   Frame shFrame;
 };
 
+// Shading normals make BSDFs non-symmetric. Transport from lights has to
+// be corrected for it, the adjoint BSDF differing from the BSDF by this.
+inline float correctShadingNormal(const Interaction& isect, const Vector3f& wo, const Vector3f& wi) {
+  auto denominator = absdot(wo, isect.n) * absdot(wi, isect.ns);
+  if (denominator == 0) return 0;
+  return absdot(wo, isect.ns) * absdot(wi, isect.n) / denominator;
+}
+
 }
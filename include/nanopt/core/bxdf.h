@@ -17,6 +17,12 @@ public:
 
   virtual Spectrum f(const Vector3f& wo, const Vector3f& wi) const = 0;
 
+  // Rough fraction of light reflected or transmitted, used for the albedo
+  // output of a render rather than for light transport.
+  virtual Spectrum albedo() const {
+    return Spectrum(0);
+  }
+
   virtual float pdf(const Vector3f&wo, const Vector3f& wi) const {
     return sameHemisphere(wo, wi) ? absCosTheta(wi) * InvPi : 0;
   }
@@ -3,6 +3,7 @@
 #include <nanopt/math/matrix4.h>
 #include <nanopt/math/bounds2.h>
 #include <nanopt/core/film.h>
+#include <nanopt/core/visibilitytester.h>
 
 namespace nanopt {
 
@@ -20,6 +21,30 @@ public:
 
   virtual Ray generateRay(const CameraSample& sample) const = 0;
 
+  // Importance carried by a ray leaving the camera, zero for rays that
+  // miss the film. pRaster receives the raster position the ray maps to.
+  virtual Spectrum we(const Ray& ray, Vector2f* pRaster = nullptr) const {
+    return Spectrum(0);
+  }
+
+  // Densities generateRay produces ray with, pdfPos per unit area of the
+  // lens and pdfDir per unit solid angle.
+  virtual void pdfWe(const Ray& ray, float& pdfPos, float& pdfDir) const {
+    pdfPos = pdfDir = 0;
+  }
+
+  // Samples a point on the lens to connect ref to, with pdf per unit
+  // solid angle at ref, the way lights are sampled for direct lighting.
+  virtual Spectrum sampleWi(
+    const Interaction& ref,
+    const Vector2f& u,
+    Vector3f& wi, float& pdf,
+    Vector2f& pRaster, VisibilityTester& tester) const {
+
+    pdf = 0;
+    return Spectrum(0);
+  }
+
 public:
   Matrix4 frame;
   Film& film;
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <nanopt/core/film.h>
+
+namespace nanopt {
+
+// Progress of a multi pass render. Samplers are reseeded from the pass
+// index and tiles are merged in a fixed order, so together with the film
+// accumulation buffers and AOVs this is all the state needed to continue
+// a render bit for bit. Splats are restored too, but not bit for bit, as
+// threads add them atomically in whatever order they get to them.
+struct RenderCheckpoint {
+  int pass = 0;
+  std::int64_t samplesTaken = 0;
+};
+
+// Writes to a temporary file first and renames it over filename, so a
+// process killed while writing leaves the previous checkpoint intact.
+void writeCheckpoint(
+  const std::string& filename,
+  const Film& film,
+  std::int64_t samplesPerPixel,
+  int samplesPerPass,
+  const RenderCheckpoint& checkpoint);
+
+// Returns false when filename does not exist and throws when it belongs
+// to a different render.
+bool readCheckpoint(
+  const std::string& filename,
+  Film& film,
+  std::int64_t samplesPerPixel,
+  int samplesPerPass,
+  RenderCheckpoint& checkpoint);
+
+}
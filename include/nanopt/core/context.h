@@ -0,0 +1,27 @@
+#pragma once
+
+#include <nanopt/core/film.h>
+#include <nanopt/core/stats.h>
+#include <nanopt/core/memory.h>
+#include <nanopt/core/sampler.h>
+
+namespace nanopt {
+
+// Everything a render thread mutates while evaluating a camera sample.
+// None of it is shared with other threads, so integrators can draw
+// samples, allocate scratch memory and record statistics without locks.
+class RenderContext {
+public:
+  RenderContext(Sampler& sampler, MemoryArena& arena, ThreadStats& stats) noexcept
+    : sampler(sampler), arena(arena), stats(stats)
+  { }
+
+public:
+  Sampler& sampler;
+  MemoryArena& arena;
+  ThreadStats& stats;
+  // Set while the film records AOVs, for the integrator to fill in.
+  AOVSample* aov = nullptr;
+};
+
+}
@@ -1,20 +1,23 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
 #include <nanopt/math/vector2.h>
+#include <nanopt/core/parallel.h>
 #include <nanopt/core/distribution1d.h>
 
 namespace nanopt {
 
 class Distribution2D {
 public:
+  // Rows are built in parallel once the thread pool is running.
   Distribution2D(const float* p, int width, int height) noexcept {
-    pConditional.reserve(height);
+    pConditional.resize(height);
     std::unique_ptr<float[]> marginal(new float[height]);
-    for (auto i = 0; i < height; ++i) {
-      pConditional.emplace_back(&p[width * i], width);
+    parallelFor([&](std::int64_t i) {
+      pConditional[i] = Distribution1D(&p[width * i], width);
       marginal[i] = pConditional[i].sum;
-    }
+    }, height, 32);
     pMarginal = Distribution1D(marginal.get(), height);
   }
 
@@ -28,10 +31,11 @@ public:
   }
 
   float pdf(const Vector2f& p) const {
+    if (pMarginal.sum == 0) return 0;
     auto w = pConditional[0].n;
     auto h = pMarginal.n;
-    auto u = (int)(w * p[0]);
-    auto v = (int)(h * p[1]);
+    auto u = std::min((int)(w * p[0]), w - 1);
+    auto v = std::min((int)(h * p[1]), h - 1);
     return pConditional[v].p[u] * pConditional[v].sum / pMarginal.sum * w * h;
   }
 
@@ -1,33 +1,204 @@
 #pragma once
 
+#include <cmath>
+#include <mutex>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <nanopt/math/math.h>
 #include <nanopt/math/bounds2.h>
+#include <nanopt/math/vector3.h>
+#include <nanopt/core/filter.h>
 #include <nanopt/core/spectrum.h>
+#include <nanopt/core/parallel.h>
 #include <nanopt/utils/imageio.h>
 
 namespace nanopt {
 
+class FilmTile;
+
+// Auxiliary outputs of the first surface a camera ray hits, used by
+// denoisers and compositing. A sample without a hit leaves primitiveId
+// negative.
+struct AOVSample {
+  Spectrum albedo = Spectrum(0);
+  Vector3f normal = Vector3f(0, 0, 0);
+  float depth = 0;
+  int primitiveId = -1;
+};
+
 class Film {
 public:
+  struct Pixel {
+    Spectrum lSum = Spectrum(0);
+    float weightSum = 0;
+    // Running luminance moments of the samples taken inside this pixel,
+    // used to estimate its variance.
+    double ySum = 0;
+    double ySquaredSum = 0;
+    int nSamples = 0;
+  };
+
+  // Unfiltered contributions landing on arbitrary pixels, such as those of
+  // light paths connected to the camera.
+  struct SplatPixel {
+    AtomicFloat rgb[3];
+  };
+
+  // Sums of the auxiliary outputs of the samples taken inside a pixel.
+  struct AOVPixel {
+    Spectrum albedoSum = Spectrum(0);
+    Vector3f normalSum = Vector3f(0, 0, 0);
+    float depthSum = 0;
+    int nHits = 0;
+    int nSamples = 0;
+    int primitiveId = -1;
+  };
+
+  // Uses a box filter covering a single pixel when filter is null.
   Film(
     const Vector2i& resolution,
-    const Bounds2f& cropWindow = Bounds2f(Vector2f(0.0f), Vector2f(1.0f)))
-      : resolution(resolution)
-      , pixelBounds(
-        Vector2i((int)std::ceil(resolution.x * cropWindow.pMin.x), (int)std::ceil(resolution.x * cropWindow.pMin.y)),
-        Vector2i((int)std::ceil(resolution.x * cropWindow.pMax.x), (int)std::ceil(resolution.y * cropWindow.pMax.y)))
-      , pixels(new Spectrum[pixelBounds.area()])
-  { }
+    const Bounds2f& cropWindow = Bounds2f(Vector2f(0.0f), Vector2f(1.0f)),
+    std::unique_ptr<Filter> filter = nullptr);
+
+  int pixelIndex(const Vector2i& p) const {
+    return (p.y - pixelBounds.pMin.y) * (pixelBounds.pMax.x - pixelBounds.pMin.x) + (p.x - pixelBounds.pMin.x);
+  }
+
+  bool insideBounds(const Vector2i& p) const {
+    return p.x >= pixelBounds.pMin.x && p.x < pixelBounds.pMax.x &&
+           p.y >= pixelBounds.pMin.y && p.y < pixelBounds.pMax.y;
+  }
+
+  void clear();
+
+  // Filters a sample at raster position pFilm into the film. Not safe to
+  // call from several threads, those render into FilmTiles instead.
+  void addSample(const Vector2f& pFilm, const Spectrum& l);
+
+  // Tile receiving the samples taken inside sampleBounds.
+  FilmTile getFilmTile(const Bounds2i& sampleBounds) const;
+
+  void mergeFilmTile(const FilmTile& tile);
+
+  // Safe to call from any thread at any time.
+  void addSplat(const Vector2f& pFilm, const Spectrum& v) {
+    Vector2i p((int)std::floor(pFilm.x), (int)std::floor(pFilm.y));
+    if (!insideBounds(p)) return;
+    auto& splat = splats[pixelIndex(p)];
+    for (auto c = 0; c < 3; ++c)
+      splat.rgb[c].add(v[c]);
+  }
+
+  // Allocates the auxiliary output buffers, integrators only record
+  // AOVs for films that have them.
+  void enableAOVs();
+
+  // Records the first hit of a camera sample. Like FilmTile, only the
+  // thread rendering the pixel pFilm falls in may call this.
+  void addAOVSample(const Vector2f& pFilm, const AOVSample& sample);
+
+  // Splat scale of integrators tracing one light path per camera sample,
+  // the pixel count over the samples the film holds. Taken from the film,
+  // it counts the samples of resumed checkpoints too.
+  float lightPathSplatScale() const;
+
+  // Standard error of the mean pixel luminance relative to the mean,
+  // infinite while there are too few samples to tell.
+  float relativeError(int index) const {
+    auto& pixel = accum[index];
+    if (pixel.nSamples < 2) return Infinity;
+    auto n = (double)pixel.nSamples;
+    auto mean = pixel.ySum / n;
+    auto variance = std::max(0.0, (pixel.ySquaredSum - pixel.ySum * mean) / (n - 1));
+    return (float)(std::sqrt(variance / n) / std::max(mean, 0.01));
+  }
+
+  // Turns the accumulated sums into the averaged image held in pixels.
+  void resolve() {
+    resolve(pixels.get());
+  }
+
+  // Same as resolve but writes into out, which holds pixelBounds.area()
+  // entries, and leaves pixels alone.
+  void resolve(Spectrum* out) const;
 
   void writeImage(const std::string& filename) {
     auto diag = pixelBounds.diag();
     nanopt::writeImage(filename, diag.x, diag.y, pixels.get());
   }
 
+  // Writes the resolved image together with the sample counts and, when
+  // enabled, the AOVs as channels of a single EXR file.
+  void writeAOVs(const std::string& filename) const;
+
+private:
+  friend class FilmTile;
+
+  // Adds a filtered sample to the pixels of bounds, stored row by row in target.
+  void addSample(Pixel* target, const Bounds2i& bounds, const Vector2f& pFilm, const Spectrum& l) const;
+
+  float filterWeight(float d) const {
+    auto i = (int)(std::abs(d) * filterTableScale);
+    return filterTable[std::min(i, FilterTableSize - 1)];
+  }
+
 public:
   Vector2i resolution;
   Bounds2i pixelBounds;
+  std::unique_ptr<Filter> filter;
   std::unique_ptr<Spectrum[]> pixels;
+  std::unique_ptr<Pixel[]> accum;
+  std::unique_ptr<SplatPixel[]> splats;
+  std::unique_ptr<AOVPixel[]> aovs;
+  // Splats are multiplied by this when resolving, light tracers set it to
+  // one over the number of light paths per pixel.
+  float splatScale = 1;
+
+private:
+  static constexpr auto FilterTableSize = 16;
+  float filterTable[FilterTableSize];
+  float filterTableScale;
+  std::mutex mergeMutex;
+};
+
+// Accumulation buffer private to one thread. It covers a tile of samples
+// grown by the filter radius and is merged into the film once complete.
+class FilmTile {
+public:
+  FilmTile(const Film& film, const Bounds2i& pixelBounds)
+    : film(&film), pixelBounds(pixelBounds), pixels(std::max(0, pixelBounds.area()))
+  { }
+
+  void addSample(const Vector2f& pFilm, const Spectrum& l) {
+    film->addSample(pixels.data(), pixelBounds, pFilm, l);
+  }
+
+public:
+  const Film* film;
+  Bounds2i pixelBounds;
+  std::vector<Film::Pixel> pixels;
+};
+
+// Merges the tiles of a pass into the film in the order of their indices,
+// whatever order they are completed in. Filters wider than a pixel make
+// neighboring tiles overlap, and the float sums of the pixels they share
+// would otherwise depend on scheduling. Tiles completed ahead of their
+// turn are held until the ones before them arrive.
+class OrderedTileMerger {
+public:
+  OrderedTileMerger(Film& film, int nTiles)
+    : film(film), tiles(nTiles)
+  { }
+
+  // Safe to call from several threads, once per index.
+  void merge(int index, FilmTile&& tile);
+
+private:
+  Film& film;
+  std::mutex m;
+  std::vector<std::unique_ptr<FilmTile>> tiles;
+  int next = 0;
 };
 
 }
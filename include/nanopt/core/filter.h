@@ -0,0 +1,27 @@
+#pragma once
+
+#include <nanopt/math/vector2.h>
+
+namespace nanopt {
+
+// Pixel reconstruction filter. All filters here are separable, the weight
+// at offset p from a pixel center is evaluate1D(p.x) * evaluate1D(p.y).
+class Filter {
+public:
+  explicit Filter(float radius) noexcept : radius(radius)
+  { }
+
+  virtual ~Filter() = default;
+
+  // Weight at distance x from the center, zero outside [-radius, radius].
+  virtual float evaluate1D(float x) const = 0;
+
+  float evaluate(const Vector2f& p) const {
+    return evaluate1D(p.x) * evaluate1D(p.y);
+  }
+
+public:
+  float radius;
+};
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <nanopt/math/math.h>
 #include <nanopt/math/vector3.h>
 
 namespace nanopt {
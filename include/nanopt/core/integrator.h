@@ -1,12 +1,99 @@
 #pragma once
 
+#include <atomic>
+#include <string>
 #include <nanopt/core/spectrum.h>
 #include <nanopt/core/scene.h>
 #include <nanopt/core/sampler.h>
+#include <nanopt/core/context.h>
 #include <nanopt/core/parallel.h>
+#include <nanopt/core/lightsampler.h>
 
 namespace nanopt {
 
+class CancellationToken {
+public:
+  void cancel() {
+    cancelled = true;
+  }
+
+  bool isCancelled() const {
+    return cancelled;
+  }
+
+private:
+  std::atomic<bool> cancelled { false };
+};
+
+enum class TileOrder {
+  RowMajor,
+  Morton,
+  Hilbert
+};
+
+struct TileRecord {
+  int pass;
+  Bounds2i bounds;
+  int thread;
+  // Seconds since the start of the pass.
+  float start, end;
+};
+
+struct RenderOptions {
+  // Samples per pixel taken by one pass over the whole frame, zero takes
+  // every sample in a single pass.
+  int samplesPerPass = 0;
+  // Wall clock budget in seconds. A pass is only started when the
+  // previous pass suggests it will finish within the budget.
+  float timeLimit = Infinity;
+  // Checked before each pass, a cancelled render keeps the passes done so far.
+  const CancellationToken* cancellation = nullptr;
+  // When set, the image after the latest pass is written here whenever
+  // snapshotInterval seconds have passed since the previous snapshot.
+  // Writing happens on a background thread so the passes never wait.
+  std::string snapshotFilename;
+  float snapshotInterval = 30;
+  // Relative error below which a pixel counts as converged and receives
+  // no more samples, zero disables adaptive sampling. The budget of
+  // samplesPerPixel per pixel is then spent on the pixels still noisy,
+  // each taking between adaptiveMinSamples and adaptiveMaxSamples
+  // (eight times samplesPerPixel when zero).
+  float adaptiveThreshold = 0;
+  int adaptiveMinSamples = 16;
+  int adaptiveMaxSamples = 0;
+  // When set, progress is saved here every checkpointInterval seconds and
+  // when a render stops early. A render that finds the file resumes from
+  // it and removes it once complete.
+  std::string checkpointFilename;
+  float checkpointInterval = 300;
+  // Tiles of tileSize pixels are handed out along tileOrder, curves keep
+  // consecutive tiles close so they share BVH nodes in cache. With
+  // minTileSize set, the last tiles of each pass are split down to that
+  // size so all threads run out of work at about the same time.
+  int tileSize = 16;
+  int minTileSize = 0;
+  TileOrder tileOrder = TileOrder::RowMajor;
+  // When set, the time each tile took is written here as CSV.
+  std::string tileLogFilename;
+  // When not degenerate, only the film pixels inside it are rendered and
+  // the rest of the film stays black.
+  Bounds2i region;
+  bool printStats = true;
+  // How direct lighting picks the light to sample.
+  LightSampling lightSampling = LightSampling::BVH;
+};
+
+struct DistributedOptions {
+  int nWorkers = 2;
+  // Threads each worker process starts, zero shares the hardware threads
+  // evenly between the workers.
+  int threadsPerWorker = 0;
+  // Side of the square crop regions handed out to the workers. Keeping it
+  // a multiple of RenderOptions::tileSize gives the same tiles, and with
+  // them the same samples, as a local render.
+  int regionSize = 64;
+};
+
 class Integrator {
 public:
   Integrator(const Camera& camera, Sampler& sampler) noexcept
@@ -15,13 +102,62 @@ public:
 
   virtual ~Integrator() = default;
 
-  virtual Spectrum li(const Ray& ray, const Scene& scene) const = 0;
+  virtual Spectrum li(const Ray& ray, const Scene& scene, RenderContext& ctx) const = 0;
 
   void render(const Scene& scene);
 
+  // Renders the frame in forked worker processes that are handed crop
+  // regions one at a time over Unix sockets, merging their results into
+  // the film. Once no regions are left, idle workers duplicate the ones
+  // still in flight and the first copy to finish is kept, so a slow or
+  // failed worker does not hold up the frame. Throws when the thread pool
+  // is running, since fork only carries the calling thread over. With the
+  // box filter and regions a multiple of RenderOptions::tileSize, the
+  // accumulated samples match a local render bit for bit. Wider filters
+  // sum the pixels regions share in another order, and splats are added
+  // in any order either way.
+  void renderDistributed(const Scene& scene, const DistributedOptions& distributed = DistributedOptions());
+
+public:
+  RenderOptions options;
+
+protected:
+  // Called by render before the first pass, builds the light sampler.
+  virtual void preprocess(const Scene& scene);
+
+  // Records the AOVs of the first hit of a camera ray, call once the
+  // scattering functions have been computed.
+  static void recordAOV(AOVSample& aov, const Ray& ray, const Interaction& isect);
+
+  // Pixels render and renderPass take samples in.
+  Bounds2i renderBounds() const;
+
+  bool isPixelActive(const Vector2i& p) const {
+    return activePixels.empty() || activePixels[camera.film.pixelIndex(p)];
+  }
+
+  // Marks the pixels adaptive sampling should keep refining and returns
+  // how many there are.
+  std::int64_t updateActivePixels(int maxSamples);
+
+  // Adds nSamples samples to every active pixel of the film, arenas holds
+  // one scratch arena per thread of the pool.
+  virtual void renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas);
+
 protected:
   const Camera& camera;
   Sampler& sampler;
+  // Set by integrators that splat one light path per camera sample, render
+  // then keeps film.splatScale in step with the samples taken.
+  bool tracesLightPaths = false;
+  std::unique_ptr<LightSampler> lightSampler;
+  // One flag per film pixel, empty while every pixel is active.
+  std::vector<char> activePixels;
+  // Filled by renderPass when options.tileLogFilename is set.
+  std::vector<TileRecord> tileLog;
 };
 
 }
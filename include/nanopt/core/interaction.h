@@ -7,14 +7,13 @@ namespace nanopt {
 
 class BSDF;
 class Triangle;
+class MemoryArena;
 
 class Interaction {
 public:
-  Interaction() noexcept : bsdf(nullptr)
+  Interaction() noexcept : bsdf(nullptr), primitiveId(-1)
   { }
 
-  ~Interaction() noexcept;
-
   Vector3f offsetRayOrigin(const Vector3f& w) const {
     return p + faceForward(n, w) * RayOriginOffsetEpsilon;
   }
@@ -31,7 +30,7 @@ public:
 
   Spectrum le(const Vector3f& w) const;
 
-  void computeScatteringFunctions();
+  void computeScatteringFunctions(MemoryArena& arena);
 
 public:
   Vector3f p;
@@ -41,6 +40,8 @@ public:
   Vector3f wo;
   BSDF* bsdf;
   const Triangle* triangle;
+  // Index of the triangle within the accelerator.
+  int primitiveId;
   static constexpr auto ShadowEpsilon = 0.0001f;
   static constexpr auto RayOriginOffsetEpsilon = 0.00001f;
 };
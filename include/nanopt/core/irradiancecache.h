@@ -0,0 +1,61 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <shared_mutex>
+#include <nanopt/math/bounds3.h>
+#include <nanopt/core/spectrum.h>
+
+namespace nanopt {
+
+// Irradiance sample with the gradients of each color channel, with respect
+// to moving the point and to rotating its normal, which interpolation
+// extrapolates along.
+struct IrradianceRecord {
+  Vector3f p;
+  Vector3f n;
+  Spectrum e;
+  Vector3f translationGradient[3];
+  Vector3f rotationGradient[3];
+  // Harmonic mean distance to the surfaces seen from p, how far the
+  // record stays valid.
+  float radius;
+};
+
+// Sparse irradiance records stored in an octree by the region they are
+// valid in. Lookups and insertions may come from any number of threads,
+// insertions taking the tree exclusively.
+class IrradianceCache {
+public:
+  explicit IrradianceCache(const Bounds3f& bounds);
+
+  ~IrradianceCache();
+
+  // Adds a record valid within maxError times its radius, the same error
+  // lookups are made with.
+  void add(const IrradianceRecord& record, float maxError);
+
+  // Irradiance at p with normal n interpolated from the records whose
+  // weight says their error is below maxError, false when there are none.
+  bool interpolate(const Vector3f& p, const Vector3f& n, float maxError, Spectrum& e) const;
+
+  int size() const;
+
+private:
+  struct Node {
+    std::vector<IrradianceRecord> records;
+    std::unique_ptr<Node> children[8];
+  };
+
+  void add(
+    Node& node, const Bounds3f& nodeBounds, int depth,
+    const IrradianceRecord& record, const Bounds3f& recordBounds);
+
+private:
+  Bounds3f bounds;
+  Node root;
+  int nRecords = 0;
+  mutable std::shared_mutex mutex;
+};
+
+}
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <optional>
+#include <nanopt/math/bounds3.h>
 #include <nanopt/core/ray.h>
 #include <nanopt/core/spectrum.h>
 #include <nanopt/core/interaction.h>
+#include <nanopt/core/lightbounds.h>
 #include <nanopt/core/visibilitytester.h>
 
 namespace nanopt {
@@ -13,12 +16,51 @@ public:
 
   virtual bool isDelta() const = 0;
 
+  // Called by the scene once its bounds are known, for lights that
+  // surround it.
+  virtual void preprocess(const Bounds3f& sceneBounds) { }
+
+  // Total emitted power, used to pick lights in proportion to it.
+  virtual Spectrum power() const = 0;
+
+  // Empty for lights without a finite extent, such as environment lights.
+  virtual std::optional<LightBounds> bounds() const = 0;
+
   virtual float pdf(const Interaction& ref, const Vector3f& w) const = 0;
 
   virtual Spectrum sample(
     const Interaction& ref,
     const Vector2f& sample,
     Vector3f& wi, float& pdf, VisibilityTester& tester) const = 0;
+
+  // Picks a point on the light independently of any shading point, with
+  // pdf per unit area, for estimators that connect one light point to
+  // several shading points. Point lights return their position with a
+  // zero normal. Lights without a position return false.
+  virtual bool samplePoint(const Vector2f& sample, Interaction& pLight, float& pdf) const {
+    return false;
+  }
+
+  // Radiance leaving a point returned by samplePoint in direction w.
+  virtual Spectrum l(const Interaction& pLight, const Vector3f& w) const {
+    return Spectrum(0);
+  }
+
+  // Samples a ray leaving the light, for tracing paths from it. pdfPos is
+  // per unit area of the origin, pdfDir per unit solid angle of the
+  // direction and nLight the normal at the origin.
+  virtual Spectrum sampleLe(
+    const Vector2f& u1, const Vector2f& u2,
+    Ray& ray, Vector3f& nLight, float& pdfPos, float& pdfDir) const {
+
+    pdfPos = pdfDir = 0;
+    return Spectrum(0);
+  }
+
+  // Densities sampleLe would have produced ray with.
+  virtual void pdfLe(const Ray& ray, const Vector3f& nLight, float& pdfPos, float& pdfDir) const {
+    pdfPos = pdfDir = 0;
+  }
 };
 
 }
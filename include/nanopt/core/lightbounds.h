@@ -0,0 +1,27 @@
+#pragma once
+
+#include <nanopt/math/vector3.h>
+#include <nanopt/math/bounds3.h>
+
+namespace nanopt {
+
+// Where and in which directions one or more lights emit, from which an
+// upper bound on their contribution to a point can be estimated. Light
+// leaves the bounds within acos(cosThetaO) of w, spreading over a further
+// acos(cosThetaE) around each emitting normal.
+struct LightBounds {
+  Bounds3f bounds;
+  Vector3f w = Vector3f(0, 0, 1);
+  float phi = 0;
+  float cosThetaO = 1;
+  float cosThetaE = 0;
+  bool twoSided = false;
+
+  // Estimated contribution to a point p with normal n, zero when the
+  // lights cannot reach it. A zero n ignores the orientation of the point.
+  float importance(const Vector3f& p, const Vector3f& n) const;
+};
+
+LightBounds merge(const LightBounds& a, const LightBounds& b);
+
+}
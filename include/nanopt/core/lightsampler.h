@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <nanopt/core/light.h>
+#include <nanopt/core/interaction.h>
+
+namespace nanopt {
+
+// Chooses which light to take a direct lighting sample from. The choice
+// may depend on the point being shaded.
+class LightSampler {
+public:
+  virtual ~LightSampler() = default;
+
+  // Returns null when there is no light to pick.
+  virtual const Light* sample(const Interaction& ref, float u, float& pmf) const = 0;
+
+  // Probability that sample picks light when shading ref.
+  virtual float pmf(const Interaction& ref, const Light& light) const = 0;
+};
+
+enum class LightSampling {
+  Uniform,
+  Power,
+  BVH
+};
+
+std::unique_ptr<LightSampler> createLightSampler(LightSampling type, const std::vector<Light*>& lights);
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <nanopt/core/bsdf.h>
+#include <nanopt/core/memory.h>
 #include <nanopt/core/interaction.h>
 
 namespace nanopt {
@@ -8,7 +9,7 @@ namespace nanopt {
 class Material {
 public:
   virtual ~Material() = default;
-  virtual void computeScatteringFunctions(Interaction& isect) const = 0;
+  virtual void computeScatteringFunctions(Interaction& isect, MemoryArena& arena) const = 0;
 };
 
 }
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <memory>
+#include <vector>
+#include <utility>
+
+namespace nanopt {
+
+// Bump allocator for short lived objects such as BSDFs. Objects created
+// here never have their destructors run, memory is recycled in bulk by
+// reset() once the current camera sample is done.
+class MemoryArena {
+public:
+  explicit MemoryArena(std::size_t blockSize = 256 * 1024) noexcept
+    : blockSize(blockSize)
+  { }
+
+  MemoryArena(const MemoryArena&) = delete;
+  MemoryArena& operator=(const MemoryArena&) = delete;
+
+  void* alloc(std::size_t nBytes, std::size_t align = alignof(std::max_align_t)) {
+    currentOffset = (currentOffset + align - 1) & ~(align - 1);
+    if (currentOffset + nBytes > currentSize)
+      nextBlock(nBytes);
+    auto ret = currentBlock + currentOffset;
+    currentOffset += nBytes;
+    return ret;
+  }
+
+  template <typename T, typename... Args>
+  T* create(Args&&... args) {
+    return new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  void reset();
+
+private:
+  using Block = std::pair<std::size_t, std::unique_ptr<std::uint8_t[]>>;
+
+  void nextBlock(std::size_t nBytes);
+
+private:
+  const std::size_t blockSize;
+  std::size_t currentOffset = 0;
+  std::size_t currentSize = 0;
+  std::uint8_t* currentBlock = nullptr;
+  std::vector<Block> usedBlocks;
+  std::vector<Block> availableBlocks;
+};
+
+}
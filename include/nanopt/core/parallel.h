@@ -1,13 +1,129 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <optional>
 #include <functional>
+#include <type_traits>
 #include <nanopt/math/vector2.h>
 
 namespace nanopt {
 
-void parallelInit();
+class AsyncTask;
+
+// Float that several threads can add to at once, using a compare and swap
+// loop on the bit pattern.
+class AtomicFloat {
+public:
+  explicit AtomicFloat(float v = 0) noexcept : bits(toBits(v))
+  { }
+
+  operator float() const {
+    return fromBits(bits.load(std::memory_order_relaxed));
+  }
+
+  AtomicFloat& operator=(float v) {
+    bits.store(toBits(v), std::memory_order_relaxed);
+    return *this;
+  }
+
+  void add(float v) {
+    auto oldBits = bits.load(std::memory_order_relaxed);
+    while (!bits.compare_exchange_weak(oldBits, toBits(fromBits(oldBits) + v), std::memory_order_relaxed))
+    { }
+  }
+
+private:
+  static std::uint32_t toBits(float v) {
+    std::uint32_t b;
+    std::memcpy(&b, &v, sizeof(b));
+    return b;
+  }
+
+  static float fromBits(std::uint32_t b) {
+    float v;
+    std::memcpy(&v, &b, sizeof(v));
+    return v;
+  }
+
+private:
+  std::atomic<std::uint32_t> bits;
+};
+
+// Starts a pool of nThreads threads including the calling one, zero uses
+// one per hardware thread.
+void parallelInit(int nThreads = 0);
 void parallelCleanup();
+
+// Index of the calling thread, zero for the thread that called
+// parallelInit and 1..N for the pool workers.
+int parallelThreadIndex();
+int parallelThreadCount();
+
 void parallelFor(std::function<void(int64_t)> func, std::int64_t count, int chunkSize = 1);
 void parallelFor2D(std::function<void(const Vector2i&)> func, const Vector2i& count);
 
+// Schedules func on the thread pool once every dependency has finished.
+std::shared_ptr<AsyncTask> parallelSubmit(
+  std::function<void()> func,
+  const std::vector<std::shared_ptr<AsyncTask>>& dependencies);
+
+// Blocks until task has finished, running other ready tasks while waiting,
+// and rethrows any exception the task raised.
+void parallelWait(const std::shared_ptr<AsyncTask>& task);
+
+template <typename T>
+class Future {
+public:
+  Future() = default;
+
+  Future(std::shared_ptr<AsyncTask> task, std::shared_ptr<std::optional<T>> value) noexcept
+    : task(std::move(task)), value(std::move(value))
+  { }
+
+  T& get() const {
+    parallelWait(task);
+    return **value;
+  }
+
+public:
+  std::shared_ptr<AsyncTask> task;
+  std::shared_ptr<std::optional<T>> value;
+};
+
+template <>
+class Future<void> {
+public:
+  Future() = default;
+
+  explicit Future(std::shared_ptr<AsyncTask> task) noexcept : task(std::move(task))
+  { }
+
+  void get() const {
+    parallelWait(task);
+  }
+
+public:
+  std::shared_ptr<AsyncTask> task;
+};
+
+template <typename F, typename... Ts>
+Future<std::invoke_result_t<F>> parallelAsync(F&& func, const Future<Ts>&... dependencies) {
+  using T = std::invoke_result_t<F>;
+  std::vector<std::shared_ptr<AsyncTask>> tasks { dependencies.task... };
+
+  if constexpr (std::is_void_v<T>) {
+    return Future<void>(parallelSubmit(std::forward<F>(func), tasks));
+  } else {
+    auto value = std::make_shared<std::optional<T>>();
+    auto task = parallelSubmit([value, func = std::forward<F>(func)]() mutable {
+      value->emplace(func());
+    }, tasks);
+    return Future<T>(std::move(task), std::move(value));
+  }
+}
+
 }
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <initializer_list>
 #include <nanopt/core/camera.h>
 
 namespace nanopt {
@@ -40,4 +41,17 @@ protected:
   std::int16_t currentPixelSampleIndex;
 };
 
+// Seed for clone identifying a random stream by a tuple of keys, such as
+// pass, stage and chunk, so streams do not depend on thread scheduling.
+inline int streamSeed(std::initializer_list<std::int64_t> keys) {
+  std::uint64_t h = 0;
+  for (auto key : keys) {
+    h ^= (std::uint64_t)key + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    h ^= h >> 31;
+  }
+  return (int)(h >> 33);
+}
+
 }
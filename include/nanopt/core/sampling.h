@@ -1,10 +1,23 @@
 #pragma once
 
+#include <cstdint>
 #include <nanopt/math/math.h>
 #include <nanopt/math/vector3.h>
 
 namespace nanopt {
 
+// Point i of an n point Hammersley set, well stratified in the unit square
+// for any n, which a random offset taken modulo one can decorrelate.
+inline Vector2f hammersley(int i, int n) {
+  auto bits = (std::uint32_t)i;
+  bits = (bits << 16) | (bits >> 16);
+  bits = ((bits & 0x55555555u) << 1) | ((bits & 0xaaaaaaaau) >> 1);
+  bits = ((bits & 0x33333333u) << 2) | ((bits & 0xccccccccu) >> 2);
+  bits = ((bits & 0x0f0f0f0fu) << 4) | ((bits & 0xf0f0f0f0u) >> 4);
+  bits = ((bits & 0x00ff00ffu) << 8) | ((bits & 0xff00ff00u) >> 8);
+  return Vector2f((i + 0.5f) / n, std::min(bits * 0x1p-32f, OneMinusEpsilon));
+}
+
 inline Vector2f uniformSampleTriangle(const Vector2f& u) {
   auto x = std::sqrt(u[0]);
   return Vector2f(1 - x, u[1] * x);
@@ -26,7 +39,22 @@ inline Vector2f uniformSampleDisk(const Vector2f& u) {
 
 inline Vector3f consineSampleHemisphere(const Vector2f& u) {
   auto p = uniformSampleDisk(u);
-  return Vector3f(p.x, p.y, std::sqrt(std::max(0.0f, 1 - p.x * p.x)));
+  return Vector3f(p.x, p.y, std::sqrt(std::max(0.0f, 1 - p.x * p.x - p.y * p.y)));
+}
+
+inline float cosineHemispherePdf(float cosTheta) {
+  return cosTheta > 0 ? cosTheta * InvPi : 0;
+}
+
+inline Vector3f uniformSampleSphere(const Vector2f& u) {
+  auto z = 1 - 2 * u[0];
+  auto r = std::sqrt(std::max(0.0f, 1 - z * z));
+  auto phi = 2 * Pi * u[1];
+  return Vector3f(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+inline float uniformSpherePdf() {
+  return Inv4Pi;
 }
 
 }
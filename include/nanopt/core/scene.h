@@ -9,18 +9,25 @@ namespace nanopt {
 
 class Scene {
 public:
+  // The environment light, if any, joins the other lights so they are
+  // sampled together, and is owned by the scene like them.
   Scene(
     const Accelerator& accel,
-    std::vector<Light*>&& lights = {}) noexcept
+    std::vector<Light*>&& lights = {},
+    InfiniteAreaLight* infiniteLight = nullptr) noexcept
       : accel(accel)
       , lights(std::move(lights))
-      , infiniteLight(nullptr)
-  { }
+      , infiniteLight(infiniteLight) {
+
+    if (infiniteLight) this->lights.push_back(infiniteLight);
+    auto bounds = accel.getBounds();
+    for (auto light : this->lights)
+      light->preprocess(bounds);
+  }
 
   ~Scene() noexcept {
     for (auto light : lights)
       delete light;
-    if (infiniteLight) delete infiniteLight;
   }
 
   bool intersect(const Ray& ray, Interaction& isect) const {
@@ -31,6 +38,14 @@ public:
     return accel.intersect(ray);
   }
 
+  void intersectStream(const Ray* rays, int n, Interaction* isects, bool* hits) const {
+    accel.intersectStream(rays, n, isects, hits);
+  }
+
+  void occludedStream(const Ray* rays, int n, bool* occluded) const {
+    accel.occludedStream(rays, n, occluded);
+  }
+
 public:
   const Accelerator& accel;
   std::vector<Light*> lights;
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <nanopt/math/bounds3.h>
+#include <nanopt/math/vector2.h>
+
+namespace nanopt {
+
+// Distribution over directions, stored as a quadtree over the unit square
+// that the sphere maps onto by cylindrical coordinates, which preserves
+// area. Energy is recorded with atomic adds, so every render thread can
+// update it without locks while it is not being sampled from.
+class DTree {
+public:
+  DTree() noexcept : nodes(1)
+  { }
+
+  bool empty() const {
+    return total() <= 0;
+  }
+
+  float total() const;
+
+  void record(const Vector3f& w, float energy);
+
+  Vector3f sample(const Vector2f& u) const;
+
+  // Pdf per unit solid angle.
+  float pdf(const Vector3f& w) const;
+
+  // Tree with the structure refined to follow the recorded energy and no
+  // energy of its own. Quadrants holding more than threshold of the total
+  // are split, those holding less are merged.
+  DTree refined(float threshold) const;
+
+private:
+  // Energy and child of each quadrant, numbered x + 2 * y. A zero child
+  // marks a leaf quadrant, the root never being anyone's child.
+  struct Node {
+    Node() noexcept {
+      for (auto i = 0; i < 4; ++i) {
+        sum[i] = 0;
+        child[i] = 0;
+      }
+    }
+
+    Node(const Node& node) noexcept {
+      for (auto i = 0; i < 4; ++i) {
+        sum[i] = node.sum[i].load(std::memory_order_relaxed);
+        child[i] = node.child[i];
+      }
+    }
+
+    Node& operator=(const Node& node) {
+      for (auto i = 0; i < 4; ++i) {
+        sum[i] = node.sum[i].load(std::memory_order_relaxed);
+        child[i] = node.child[i];
+      }
+      return *this;
+    }
+
+    float total() const {
+      return sum[0] + sum[1] + sum[2] + sum[3];
+    }
+
+    std::atomic<float> sum[4];
+    int child[4];
+  };
+
+  void refine(const DTree& from, int fromIndex, const float fraction[4], int index, int depth, float threshold);
+
+private:
+  std::vector<Node> nodes;
+};
+
+// Spatial binary tree over the scene whose leaves each hold the DTree
+// learned from the samples recorded inside them during the previous pass,
+// for sampling, and the one being recorded into during the current pass.
+// The spatial structure only changes in refine, between passes.
+class SDTree {
+public:
+  explicit SDTree(const Bounds3f& bounds);
+
+  // Distribution learned at p, empty until a pass has been recorded.
+  const DTree& sampling(const Vector3f& p) const {
+    return leaves[leafIndex(p)]->sampling;
+  }
+
+  // Records radiance arriving at p from direction w, divided by the pdf
+  // w was sampled with. Safe to call from any number of threads.
+  void record(const Vector3f& p, const Vector3f& w, float energy);
+
+  // Makes the energy recorded so far the one sampled from and splits the
+  // leaves that recorded more than spatialThreshold samples.
+  void refine(int spatialThreshold, float directionalThreshold);
+
+private:
+  struct Leaf {
+    DTree sampling;
+    DTree building;
+    std::atomic<int> nSamples { 0 };
+  };
+
+  struct Node {
+    // First of two children, zero for leaves, which index leaves
+    // instead. Axis is the one split along, or to split along next.
+    int child;
+    int leaf;
+    int axis;
+  };
+
+  int leafIndex(const Vector3f& p) const;
+
+  void split(int index, int threshold);
+
+private:
+  Bounds3f bounds;
+  std::vector<Node> nodes;
+  std::vector<std::unique_ptr<Leaf>> leaves;
+};
+
+}
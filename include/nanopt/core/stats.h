@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <ostream>
+
+namespace nanopt {
+
+enum class StatCounter {
+  CameraRays,
+  IntersectionRays,
+  ShadowRays,
+  BVHNodesVisited,
+  TriangleTests,
+  BSDFSamples,
+  RussianRouletteTerminations,
+  IrradianceRecords,
+  Count
+};
+
+enum class StatDistribution {
+  PathLength,
+  Count
+};
+
+struct DistributionStats {
+  std::int64_t sum = 0;
+  std::int64_t count = 0;
+  std::int64_t min = INT64_MAX;
+  std::int64_t max = INT64_MIN;
+
+  void report(std::int64_t value) {
+    sum += value;
+    ++count;
+    if (value < min) min = value;
+    if (value > max) max = value;
+  }
+
+  void merge(const DistributionStats& d) {
+    sum += d.sum;
+    count += d.count;
+    if (d.min < min) min = d.min;
+    if (d.max > max) max = d.max;
+  }
+
+  double average() const {
+    return count ? (double)sum / count : 0;
+  }
+};
+
+// Each thread owns one block and is the only writer to it, so recording
+// is a plain add without atomics. Blocks are merged once the worker
+// threads are idle again.
+class ThreadStats {
+public:
+  void clear() {
+    *this = ThreadStats();
+  }
+
+  void merge(const ThreadStats& stats) {
+    for (auto i = 0; i < (int)StatCounter::Count; ++i)
+      counters[i] += stats.counters[i];
+    for (auto i = 0; i < (int)StatDistribution::Count; ++i)
+      distributions[i].merge(stats.distributions[i]);
+  }
+
+  std::int64_t get(StatCounter counter) const {
+    return counters[(int)counter];
+  }
+
+  const DistributionStats& get(StatDistribution distribution) const {
+    return distributions[(int)distribution];
+  }
+
+public:
+  std::int64_t counters[(int)StatCounter::Count] = { };
+  DistributionStats distributions[(int)StatDistribution::Count];
+};
+
+ThreadStats* registerThreadStats();
+
+inline ThreadStats& threadStats() {
+  static thread_local ThreadStats* stats = nullptr;
+  if (!stats) stats = registerThreadStats();
+  return *stats;
+}
+
+void clearStats();
+ThreadStats mergeStats();
+void printStats(std::ostream& os);
+void writeStatsJSON(const std::string& filename);
+
+}
+
+// The _TO variants record into a block the caller already holds, such as
+// the one in a RenderContext, and skip the thread local lookup.
+#ifdef NANOPT_ENABLE_STATS
+#define NANOPT_STAT_ADD_TO(stats, counter, n) \
+  ((stats).counters[(int)nanopt::StatCounter::counter] += (n))
+#define NANOPT_STAT_REPORT_TO(stats, distribution, value) \
+  (stats).distributions[(int)nanopt::StatDistribution::distribution].report(value)
+#define NANOPT_STAT_ADD(counter, n) NANOPT_STAT_ADD_TO(nanopt::threadStats(), counter, n)
+#define NANOPT_STAT_REPORT(distribution, value) \
+  NANOPT_STAT_REPORT_TO(nanopt::threadStats(), distribution, value)
+#else
+#define NANOPT_STAT_ADD_TO(stats, counter, n) ((void)(stats), (void)(n))
+#define NANOPT_STAT_REPORT_TO(stats, distribution, value) ((void)(stats), (void)(value))
+#define NANOPT_STAT_ADD(counter, n) ((void)(n))
+#define NANOPT_STAT_REPORT(distribution, value) ((void)(value))
+#endif
+
+#define NANOPT_STAT_INC_TO(stats, counter) NANOPT_STAT_ADD_TO(stats, counter, 1)
+#define NANOPT_STAT_INC(counter) NANOPT_STAT_ADD(counter, 1)
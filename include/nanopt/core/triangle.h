@@ -33,6 +33,14 @@ public:
     return cross(b - a, b - c).length() / 2;
   }
 
+  // Geometric normal, the side one-sided area lights emit towards.
+  Vector3f normal() const {
+    auto& a = mesh->p[indices[0]];
+    auto& b = mesh->p[indices[1]];
+    auto& c = mesh->p[indices[2]];
+    return normalize(cross(c - a, b - a));
+  }
+
   float pdf(const Interaction& ref, const Vector3f& w) const {
     Interaction isect;
     auto ray = ref.spawnRay(w);
@@ -14,6 +14,10 @@ public:
     : ref(&ref), target(target)
   { }
 
+  Ray shadowRay() const {
+    return ref->spawnRayTo(target);
+  }
+
   bool unoccluded(const Scene& scene) const;
 
 private:
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cmath>
+#include <nanopt/math/math.h>
+#include <nanopt/core/filter.h>
+
+namespace nanopt {
+
+// Four term Blackman-Harris window stretched over [-radius, radius].
+class BlackmanHarrisFilter : public Filter {
+public:
+  explicit BlackmanHarrisFilter(float radius = 1.5f) noexcept : Filter(radius)
+  { }
+
+  float evaluate1D(float x) const override {
+    if (std::abs(x) > radius) return 0;
+    auto t = 2 * Pi * (x / (2 * radius) + 0.5f);
+    return 0.35875f - 0.48829f * std::cos(t) + 0.14128f * std::cos(2 * t) - 0.01168f * std::cos(3 * t);
+  }
+};
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cmath>
+#include <nanopt/core/filter.h>
+
+namespace nanopt {
+
+class BoxFilter : public Filter {
+public:
+  explicit BoxFilter(float radius = 0.5f) noexcept : Filter(radius)
+  { }
+
+  float evaluate1D(float x) const override {
+    return std::abs(x) <= radius ? 1.0f : 0.0f;
+  }
+};
+
+}
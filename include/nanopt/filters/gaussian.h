@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <nanopt/core/filter.h>
+
+namespace nanopt {
+
+// Gaussian shifted down so it reaches zero at the radius.
+class GaussianFilter : public Filter {
+public:
+  explicit GaussianFilter(float radius = 1.5f, float alpha = 2.0f) noexcept
+    : Filter(radius), alpha(alpha), expRadius(std::exp(-alpha * radius * radius))
+  { }
+
+  float evaluate1D(float x) const override {
+    return std::max(0.0f, std::exp(-alpha * x * x) - expRadius);
+  }
+
+private:
+  float alpha;
+  float expRadius;
+};
+
+}
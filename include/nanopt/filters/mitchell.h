@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cmath>
+#include <nanopt/core/filter.h>
+
+namespace nanopt {
+
+// Mitchell-Netravali cubic, b = c = 1/3 is the recommended tradeoff
+// between ringing and blur.
+class MitchellFilter : public Filter {
+public:
+  explicit MitchellFilter(float radius = 2.0f, float b = 1.0f / 3, float c = 1.0f / 3) noexcept
+    : Filter(radius), b(b), c(c)
+  { }
+
+  float evaluate1D(float x) const override {
+    x = std::abs(2 * x / radius);
+    if (x > 2) return 0;
+    if (x > 1) {
+      return ((-b - 6 * c) * x * x * x + (6 * b + 30 * c) * x * x +
+              (-12 * b - 48 * c) * x + (8 * b + 24 * c)) / 6;
+    }
+    return ((12 - 9 * b - 6 * c) * x * x * x + (-18 + 12 * b + 6 * c) * x * x +
+            (6 - 2 * b)) / 6;
+  }
+
+private:
+  float b, c;
+};
+
+}
@@ -1,38 +1,45 @@
 #pragma once
 
-#include <nanopt/core/frame.h>
-#include <nanopt/core/sampling.h>
+#include <memory>
+#include <vector>
+#include <nanopt/core/mesh.h>
 #include <nanopt/core/integrator.h>
 
-
 namespace nanopt {
 
+// Fraction of a cosine weighted hemisphere left unoccluded within
+// maxDistance. The rays of one point share an origin, so they are traced
+// as one batch through the accelerator's occlusion stream, their
+// directions coming from a Hammersley set randomly offset per point.
 class AmbientOcclusionIntegrator : public Integrator {
 public:
-  AmbientOcclusionIntegrator(const Camera& camera, Sampler& sampler, int samples)
-    : Integrator(camera, sampler), samples(samples)
+  AmbientOcclusionIntegrator(const Camera& camera, Sampler& sampler, int samples, float maxDistance = 1.0f)
+    : Integrator(camera, sampler), samples(samples), maxDistance(maxDistance)
   { }
 
-  Spectrum li(const Ray& ray, const Scene& scene) const override {
-    Interaction isect;
-    if (scene.intersect(ray, isect)) {
-      Spectrum ret(0);
-      for (auto i = 0; i < samples; ++i) {
-        auto p = consineSampleHemisphere(sampler.get2D());
-        auto frame = Frame(isect.n);
-        auto w = frame.toWorld(p);
-        auto r = isect.spawnRay(w);
-        r.tMax = 1.0f;
-        auto ao = scene.intersect(r) ? Spectrum(0) : Spectrum(1);
-        ret += ao;
-      }
-      return ret / samples;
-    }
-    return Spectrum(0);
-  }
+  Spectrum li(const Ray& ray, const Scene& scene, RenderContext& ctx) const override;
+
+  // Ambient occlusion at every vertex of a mesh that is part of the scene,
+  // around its normal, or the area weighted normal of its faces when the
+  // mesh has none.
+  std::vector<float> bakeVertices(const Mesh& mesh, const Scene& scene, int seed = 0) const;
+
+  // Ambient occlusion at the texels the mesh's uv layout covers, row zero
+  // being the top of the texture, so the result can go to writeImage.
+  // Texels no triangle covers are left black.
+  std::unique_ptr<Spectrum[]> bakeTexture(
+    const Mesh& mesh, const Scene& scene,
+    const Vector2i& resolution, int seed = 0) const;
 
 public:
   int samples;
+  float maxDistance;
+
+private:
+  float visibility(
+    const Scene& scene,
+    const Vector3f& p, const Vector3f& n,
+    const Vector2f& offset, MemoryArena& arena) const;
 };
 
 }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <nanopt/core/integrator.h>
+
+namespace nanopt {
+
+// Bidirectional path tracer. Each camera sample traces a subpath from the
+// camera and one from a light and connects every pair of their vertices,
+// weighting each strategy with the balance heuristic, which finds the
+// caustics a path tracer can only reach by hitting small lights. Paths
+// through the camera's own vertex are splatted to wherever they land on
+// the film, so images need a film resolved after the render.
+class BDPTIntegrator : public Integrator {
+public:
+  BDPTIntegrator(const Camera& camera, Sampler& sampler, int maxDepth = 5) noexcept
+    : Integrator(camera, sampler)
+    , maxDepth(maxDepth)
+  {
+    tracesLightPaths = true;
+  }
+
+  Spectrum li(const Ray& ray, const Scene& scene, RenderContext& ctx) const override;
+
+protected:
+  void preprocess(const Scene& scene) override;
+
+public:
+  int maxDepth;
+
+private:
+  // Picks the light subpaths start from, by power since the choice cannot
+  // depend on a shading point.
+  std::unique_ptr<LightSampler> lightDistribution;
+};
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <nanopt/core/sdtree.h>
+#include <nanopt/integrators/path.h>
+
+namespace nanopt {
+
+// Path tracer that learns where indirect light comes from over the passes
+// of a progressive render, in an SDTree, and samples directions from it
+// as well as from the BSDF. Passes are grouped into training iterations
+// of doubling length, each sampling the distribution learned during the
+// previous iteration while recording into a new one, so every pass stays
+// unbiased; the first samples the BSDF only. Guided renders take
+// samplesPerPass samples per pass, defaulting to a few, since a single
+// pass would learn nothing it could use.
+class GuidedPathIntegrator : public PathIntegrator {
+public:
+  GuidedPathIntegrator(const Camera& camera, Sampler& sampler, int maxDepth = 5)
+    : PathIntegrator(camera, sampler, maxDepth)
+  {
+    options.samplesPerPass = 4;
+  }
+
+  Spectrum li(const Ray& ray, const Scene& scene, RenderContext& ctx) const override;
+
+protected:
+  void preprocess(const Scene& scene) override;
+
+  void renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas) override;
+
+public:
+  // Probability of sampling the BSDF rather than the learned distribution.
+  float bsdfSamplingFraction = 0.5f;
+  // A spatial cell is split once it records more than this many samples
+  // in an iteration, scaled by the square root of the iteration's samples
+  // per pixel.
+  int spatialThreshold = 12000;
+  // Share of a cell's energy above which a direction quadrant is split.
+  float directionalThreshold = 0.01f;
+
+private:
+  std::unique_ptr<SDTree> sdTree;
+};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <nanopt/core/irradiancecache.h>
+#include <nanopt/integrators/path.h>
+
+namespace nanopt {
+
+// Fast preview path tracer that treats indirect light on non-specular
+// surfaces as diffuse and interpolates the irradiance it brings from an
+// IrradianceCache. Shading points that no record covers well enough
+// compute a new one by path tracing a stratified hemisphere, so records
+// are only made where they are needed, by whichever thread needs them
+// first. The image therefore depends on thread scheduling, and glossy
+// surfaces get diffuse interreflections.
+class IrradianceCacheIntegrator : public PathIntegrator {
+public:
+  IrradianceCacheIntegrator(
+      const Camera& camera,
+      Sampler& sampler,
+      int maxDepth = 5,
+      float maxError = 0.3f,
+      int nThetaSamples = 8)
+    : PathIntegrator(camera, sampler, maxDepth)
+    , maxError(maxError)
+    , nThetaSamples(nThetaSamples)
+  { }
+
+  Spectrum li(const Ray& ray, const Scene& scene, RenderContext& ctx) const override;
+
+protected:
+  void preprocess(const Scene& scene) override;
+
+public:
+  // Largest error a record is interpolated with, as a fraction of its
+  // radius, smaller values make more records.
+  float maxError;
+  // Hemisphere rays of a record are stratified into nThetaSamples by
+  // about Pi times as many cells.
+  int nThetaSamples;
+  // Bounds on the radius of records, as fractions of the scene diagonal.
+  float minSpacing = 0.001f;
+  float maxSpacing = 0.1f;
+
+private:
+  IrradianceRecord computeRecord(
+    const Interaction& isect, const Vector3f& n,
+    const Scene& scene, RenderContext& ctx) const;
+
+private:
+  std::unique_ptr<IrradianceCache> cache;
+  float sceneDiagonal = 0;
+};
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <nanopt/core/integrator.h>
+
+namespace nanopt {
+
+// Light tracer. Each camera sample traces one path from a light, picked
+// by power, and connects every vertex of it to the camera, splatting the
+// result wherever it lands on the film. Caustics seen directly converge
+// far faster than with a path tracer, while glossy and specular surfaces
+// seen directly are never found. Camera rays are only traced when the
+// scene has an environment light, the one thing they can see that light
+// paths cannot reach. As with BDPT, the film has to be resolved after the
+// render.
+class LightTracingIntegrator : public Integrator {
+public:
+  LightTracingIntegrator(const Camera& camera, Sampler& sampler, int maxDepth = 5) noexcept
+    : Integrator(camera, sampler)
+    , maxDepth(maxDepth)
+  {
+    tracesLightPaths = true;
+  }
+
+  Spectrum li(const Ray& ray, const Scene& scene, RenderContext& ctx) const override;
+
+protected:
+  void preprocess(const Scene& scene) override;
+
+public:
+  int maxDepth;
+
+private:
+  // Connects a vertex with throughput beta to the camera and splats it.
+  void splatToCamera(
+    const Interaction& isect, const Spectrum& beta,
+    const Scene& scene, RenderContext& ctx) const;
+
+private:
+  std::unique_ptr<LightSampler> lightDistribution;
+};
+
+}
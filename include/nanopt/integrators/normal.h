@@ -10,7 +10,7 @@ public:
     : Integrator(camera, sampler)
   { }
 
-  Spectrum li(const Ray& ray, const Scene& scene) const override {
+  Spectrum li(const Ray& ray, const Scene& scene, RenderContext& ctx) const override {
     Interaction isect;
     if (scene.intersect(ray, isect))
       return Spectrum(abs(isect.ns));
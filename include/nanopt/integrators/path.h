@@ -15,19 +15,19 @@ public:
     return (a * a) / (a * a + b * b);
   }
 
-  Spectrum li(const Ray& ray, const Scene& scene) const override;
+  Spectrum li(const Ray& ray, const Scene& scene, RenderContext& ctx) const override;
 
   Spectrum estimateDirect(
     const Interaction& isect,
     const Light& light,
-    const Scene& scene) const;
-
-  Spectrum sampleOneLight(const Interaction& isect, const Scene& scene) const {
-    auto nLights = scene.lights.size();
-    if (!nLights) return Spectrum(0);
-    auto lightIndex = std::min((std::size_t)(sampler.get1D() * nLights), nLights - 1);
-    auto light = scene.lights[lightIndex];
-    return estimateDirect(isect, *light, scene) * nLights;
+    const Scene& scene,
+    RenderContext& ctx) const;
+
+  Spectrum sampleOneLight(const Interaction& isect, const Scene& scene, RenderContext& ctx) const {
+    float lightPmf;
+    auto light = lightSampler->sample(isect, ctx.sampler.get1D(), lightPmf);
+    if (!light) return Spectrum(0);
+    return estimateDirect(isect, *light, scene, ctx) / lightPmf;
   }
 
 public:
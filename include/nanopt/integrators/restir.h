@@ -0,0 +1,98 @@
+#pragma once
+
+#include <nanopt/core/integrator.h>
+
+namespace nanopt {
+
+// Direct lighting by reservoir based spatiotemporal importance resampling.
+// Every pixel resamples many unshadowed light samples down to one, merges
+// the result with the reservoir it kept from its previous sample and with
+// those of nearby pixels seeing similar surfaces, and traces a single
+// shadow ray for the sample that survives. Merged reservoirs are weighted
+// by the pixels that could have produced the chosen sample, so reuse adds
+// no bias. Lights without a position, such as environment lights, are
+// sampled directly instead.
+class ReSTIRDirectIntegrator : public Integrator {
+public:
+  ReSTIRDirectIntegrator(
+      const Camera& camera,
+      Sampler& sampler,
+      int nCandidates = 32,
+      int nSpatialNeighbors = 5,
+      float spatialRadius = 10,
+      bool temporalReuse = true) noexcept
+    : Integrator(camera, sampler)
+    , nCandidates(nCandidates)
+    , nSpatialNeighbors(nSpatialNeighbors)
+    , spatialRadius(spatialRadius)
+    , temporalReuse(temporalReuse)
+  { }
+
+  // Resamples the candidates of a single shading point, without reuse.
+  Spectrum li(const Ray& ray, const Scene& scene, RenderContext& ctx) const override;
+
+protected:
+  void preprocess(const Scene& scene) override;
+
+  void renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas) override;
+
+private:
+  // First hit seen through a pixel.
+  struct Surface {
+    Interaction isect;
+    float depth = 0;
+    bool valid = false;
+  };
+
+  // Light point chosen from a stream of weighted candidates. W is the
+  // unbiased estimate of one over its target pdf, M the candidate count.
+  struct Reservoir {
+    bool update(const Light* light, const Interaction& pLight, float w, float u) {
+      wSum += w;
+      if (w <= 0 || u * wSum >= w) return false;
+      this->light = light;
+      p = pLight.p;
+      n = pLight.n;
+      return true;
+    }
+
+    const Light* light = nullptr;
+    Vector3f p = Vector3f(0, 0, 0);
+    Vector3f n = Vector3f(0, 0, 0);
+    float wSum = 0;
+    float W = 0;
+    int M = 0;
+  };
+
+  Reservoir sampleCandidates(const Interaction& isect, Sampler& sampler) const;
+
+  // Merges reservoirs gathered for domains[0], domains[i] being the
+  // surface reservoirs[i] was built for.
+  Reservoir combine(const Surface* const* domains, const Reservoir* const* reservoirs, int n, Sampler& sampler) const;
+
+  Spectrum shade(const Interaction& isect, const Reservoir& r, const Scene& scene, Sampler& sampler) const;
+
+public:
+  int nCandidates;
+  int nSpatialNeighbors;
+  float spatialRadius;
+  bool temporalReuse;
+
+private:
+  std::unique_ptr<LightSampler> candidateSampler;
+  std::vector<Light*> unboundedLights;
+  // Surfaces of the current and the previous camera sample of every film
+  // pixel, with arenas holding their BSDFs, and the reservoirs of the
+  // previous sample before spatial reuse. Feeding spatially merged
+  // reservoirs back in would let a pixel reuse its neighbors' samples
+  // over and over, which correlates the whole image.
+  std::vector<Surface> surfaces[2];
+  std::vector<std::unique_ptr<MemoryArena>> surfaceArenas[2];
+  std::vector<Reservoir> history;
+  int current = 0;
+};
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <nanopt/integrators/path.h>
+
+namespace nanopt {
+
+// Stochastic progressive photon mapping. Every iteration traces one camera
+// path per pixel through specular surfaces to a visible point, inserts the
+// visible points into a spatial hash grid, then shoots photons from the
+// lights and adds each photon landing within a visible point's radius to
+// it. Radii shrink as photons arrive, so the estimate converges, and only
+// per pixel state is kept, so memory does not grow with the photon count.
+// Each sample of a pass is one iteration; the image is written into the
+// film after every pass, which checkpoints and adaptive sampling do not
+// understand.
+class SPPMIntegrator : public PathIntegrator {
+public:
+  SPPMIntegrator(
+      const Camera& camera,
+      Sampler& sampler,
+      int maxDepth = 5,
+      int photonsPerIteration = 0,
+      float initialRadius = 0)
+    : PathIntegrator(camera, sampler, maxDepth)
+    , photonsPerIteration(photonsPerIteration)
+    , initialRadius(initialRadius)
+  {
+    options.samplesPerPass = 1;
+  }
+
+protected:
+  void preprocess(const Scene& scene) override;
+
+  void renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas) override;
+
+public:
+  // Zero shoots one photon per rendered pixel.
+  int photonsPerIteration;
+  // Zero starts at a hundredth of the scene's diagonal.
+  float initialRadius;
+
+private:
+  struct VisiblePoint {
+    Vector3f p;
+    Vector3f wo;
+    const BSDF* bsdf = nullptr;
+    Spectrum beta = Spectrum(0);
+    // Bounces the camera path took to reach it, which count towards
+    // maxDepth along with those of the photons it gathers.
+    int depth = 0;
+  };
+
+  struct Pixel {
+    float radius = 0;
+    // Direct and emitted light summed over the iterations.
+    Spectrum ld = Spectrum(0);
+    VisiblePoint vp;
+    // Photon flux gathered during the current iteration.
+    AtomicFloat phi[3];
+    std::atomic<int> m { 0 };
+    // Photon count and flux accumulated by the progressive updates.
+    float n = 0;
+    Spectrum tau = Spectrum(0);
+  };
+
+  // Picks the light photons start from, by power.
+  std::unique_ptr<LightSampler> photonLightSampler;
+  std::unique_ptr<Pixel[]> pixels;
+  // One per thread, holding the visible points' BSDFs and the grid for
+  // the length of an iteration.
+  std::vector<std::unique_ptr<MemoryArena>> iterationArenas;
+  int nIterations = 0;
+};
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <nanopt/integrators/path.h>
+
+namespace nanopt {
+
+// Path tracer that advances a whole batch of paths one stage at a time
+// instead of tracing each path to completion. Path state lives in
+// structure of arrays form and each stage runs over a compacted queue,
+// so rays are handed to the accelerator as streams and shading is
+// grouped by material. Converges to the same image as PathIntegrator.
+class WavefrontPathIntegrator : public PathIntegrator {
+public:
+  WavefrontPathIntegrator(
+      const Camera& camera,
+      Sampler& sampler,
+      int maxDepth = 5,
+      int maxQueueSize = 1 << 16) noexcept
+    : PathIntegrator(camera, sampler, maxDepth)
+    , maxQueueSize(maxQueueSize)
+  { }
+
+protected:
+  void renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas) override;
+
+public:
+  int maxQueueSize;
+};
+
+}
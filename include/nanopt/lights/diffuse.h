@@ -1,6 +1,8 @@
 #pragma once
 
+#include <nanopt/core/frame.h>
 #include <nanopt/core/light.h>
+#include <nanopt/core/sampling.h>
 #include <nanopt/core/triangle.h>
 
 namespace nanopt {
@@ -19,6 +21,19 @@ public:
     return false;
   }
 
+  Spectrum power() const override {
+    return intensity * shape->area() * Pi * (twoSided ? 2.0f : 1.0f);
+  }
+
+  std::optional<LightBounds> bounds() const override {
+    LightBounds b;
+    b.bounds = shape->getBounds();
+    b.w = shape->normal();
+    b.phi = power().y();
+    b.twoSided = twoSided;
+    return b;
+  }
+
   Spectrum le(const Interaction& pLight, const Vector3f& wo) const {
     if (twoSided || dot(pLight.n, wo) > 0)
       return intensity;
@@ -40,6 +55,46 @@ public:
     return le(pLight, -wi);
   }
 
+  bool samplePoint(const Vector2f& sample, Interaction& pLight, float& pdf) const override {
+    pLight = shape->sample(sample, pdf);
+    return true;
+  }
+
+  Spectrum l(const Interaction& pLight, const Vector3f& w) const override {
+    return le(pLight, w);
+  }
+
+  Spectrum sampleLe(
+    const Vector2f& u1, const Vector2f& u2,
+    Ray& ray, Vector3f& nLight, float& pdfPos, float& pdfDir) const override {
+
+    auto pLight = shape->sample(u1, pdfPos);
+    nLight = pLight.n;
+
+    // Two-sided lights send half of their rays out of the back.
+    auto u = u2;
+    auto back = false;
+    if (twoSided) {
+      back = u[0] >= 0.5f;
+      u[0] = std::min((back ? u[0] - 0.5f : u[0]) * 2, OneMinusEpsilon);
+    }
+    auto w = consineSampleHemisphere(u);
+    pdfDir = cosineHemispherePdf(w.z) * (twoSided ? 0.5f : 1.0f);
+    if (back) w.z = -w.z;
+
+    auto wWorld = Frame(nLight).toWorld(w);
+    ray = pLight.spawnRay(wWorld);
+    return le(pLight, wWorld);
+  }
+
+  void pdfLe(const Ray& ray, const Vector3f& nLight, float& pdfPos, float& pdfDir) const override {
+    pdfPos = 1 / shape->area();
+    auto cosTheta = dot(nLight, ray.d);
+    pdfDir = twoSided
+      ? 0.5f * cosineHemispherePdf(std::abs(cosTheta))
+      : cosineHemispherePdf(cosTheta);
+  }
+
 public:
   Triangle* shape;
   Spectrum intensity;
@@ -1,30 +1,84 @@
 #pragma once
 
+#include <memory>
+#include <string>
+#include <nanopt/math/matrix4.h>
 #include <nanopt/core/light.h>
+#include <nanopt/core/distribution2d.h>
 
 namespace nanopt {
 
+// Environment light surrounding the scene with the radiance of an
+// equirectangular map, whose top row is the +y axis of lightToWorld.
+// Directions are importance sampled in proportion to the map's luminance
+// times sin theta, so bright skies and suns are found by light sampling
+// rather than by chance. Texels are looked up without filtering, keeping
+// the radiance and the sampling density in step.
 class InfiniteAreaLight : public Light {
 public:
+  // Loads the map through readImage, EXR for high dynamic range. The
+  // sampling distribution is built in parallel when the thread pool is
+  // running, which is worth it for 8K maps.
+  explicit InfiniteAreaLight(
+    const std::string& filename,
+    const Spectrum& scale = Spectrum(1),
+    const Matrix4& lightToWorld = Matrix4::identity());
+
+  InfiniteAreaLight(
+    std::unique_ptr<Spectrum[]> lmap, int width, int height,
+    const Spectrum& scale = Spectrum(1),
+    const Matrix4& lightToWorld = Matrix4::identity());
+
   bool isDelta() const override {
     return false;
   }
 
-  Spectrum le(const Ray& ray) const {
-    return Spectrum(0);
-  }
+  void preprocess(const Bounds3f& sceneBounds) override;
+
+  Spectrum power() const override;
 
-  float pdf(const Interaction& ref, const Vector3f& w) const override {
-    return 1;
+  std::optional<LightBounds> bounds() const override {
+    return std::nullopt;
   }
 
+  // Radiance arriving along a ray that left the scene.
+  Spectrum le(const Ray& ray) const;
+
+  float pdf(const Interaction& ref, const Vector3f& w) const override;
+
   Spectrum sample(
     const Interaction& ref,
     const Vector2f& sample,
-    Vector3f& wi, float& pdf, VisibilityTester& tester) const override {
+    Vector3f& wi, float& pdf, VisibilityTester& tester) const override;
 
-    return Spectrum(0);
-  }
+  // Rays start on a disk facing the sampled direction, just outside the
+  // scene's bounding sphere, so pdfPos is per unit area of that disk.
+  Spectrum sampleLe(
+    const Vector2f& u1, const Vector2f& u2,
+    Ray& ray, Vector3f& nLight, float& pdfPos, float& pdfDir) const override;
+
+  void pdfLe(const Ray& ray, const Vector3f& nLight, float& pdfPos, float& pdfDir) const override;
+
+private:
+  void buildDistribution(const Spectrum& scale);
+
+  Vector2f directionToUV(const Vector3f& w) const;
+
+  Vector3f uvToDirection(const Vector2f& uv) const;
+
+  Spectrum lookup(const Vector2f& uv) const;
+
+  // Density per unit solid angle of the direction at uv.
+  float directionPdf(const Vector2f& uv) const;
+
+private:
+  std::unique_ptr<Spectrum[]> lmap;
+  int width, height;
+  Matrix4 lightToWorld;
+  Matrix4 worldToLight;
+  std::unique_ptr<Distribution2D> distribution;
+  Vector3f worldCenter;
+  float worldRadius = 0;
 };
 
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <nanopt/core/light.h>
+#include <nanopt/core/sampling.h>
 #include <nanopt/core/interaction.h>
 #include <nanopt/core/visibilitytester.h>
 
@@ -16,6 +17,18 @@ public:
     return true;
   }
 
+  Spectrum power() const override {
+    return intensity * 4 * Pi;
+  }
+
+  std::optional<LightBounds> bounds() const override {
+    LightBounds b;
+    b.bounds = Bounds3f(pLight);
+    b.phi = power().y();
+    b.cosThetaO = -1;
+    return b;
+  }
+
   float pdf(const Interaction& ref, const Vector3f& w) const override {
     return 0;
   }
@@ -32,6 +45,33 @@ public:
     return intensity / d.lengthSquared();
   }
 
+  bool samplePoint(const Vector2f& sample, Interaction& p, float& pdf) const override {
+    p.p = pLight;
+    p.n = Vector3f(0, 0, 0);
+    pdf = 1;
+    return true;
+  }
+
+  Spectrum l(const Interaction& p, const Vector3f& w) const override {
+    return intensity;
+  }
+
+  Spectrum sampleLe(
+    const Vector2f& u1, const Vector2f& u2,
+    Ray& ray, Vector3f& nLight, float& pdfPos, float& pdfDir) const override {
+
+    ray = Ray(pLight, uniformSampleSphere(u1));
+    nLight = ray.d;
+    pdfPos = 1;
+    pdfDir = uniformSpherePdf();
+    return intensity;
+  }
+
+  void pdfLe(const Ray& ray, const Vector3f& nLight, float& pdfPos, float& pdfDir) const override {
+    pdfPos = 0;
+    pdfDir = uniformSpherePdf();
+  }
+
 public:
   Vector3f pLight;
   Spectrum intensity;
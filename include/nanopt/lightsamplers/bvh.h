@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <nanopt/core/lightsampler.h>
+
+namespace nanopt {
+
+// Picks lights by walking a hierarchy over their bounds from the root,
+// choosing each child in proportion to the importance its bounds give the
+// shading point. Lights without bounds are picked uniformly, with the
+// hierarchy as a whole counting as one more of them.
+class BVHLightSampler : public LightSampler {
+public:
+  explicit BVHLightSampler(const std::vector<Light*>& lights);
+
+  const Light* sample(const Interaction& ref, float u, float& pmf) const override;
+
+  float pmf(const Interaction& ref, const Light& light) const override;
+
+private:
+  struct Node {
+    LightBounds lightBounds;
+    // Second child of interior nodes, the first directly follows its
+    // parent. Index into boundedLights for leaves.
+    int childOrLightIndex;
+    bool isLeaf;
+  };
+
+  int build(std::vector<std::pair<int, LightBounds>>& bvhLights, int begin, int end, std::uint64_t bitTrail, int depth);
+
+  float probabilityOfInfinite() const {
+    auto nInfinite = (float)infiniteLights.size();
+    return nInfinite / (nInfinite + (nodes.empty() ? 0 : 1));
+  }
+
+public:
+  std::vector<const Light*> boundedLights;
+  std::vector<const Light*> infiniteLights;
+
+private:
+  std::vector<Node> nodes;
+  // Path from the root to the leaf of each bounded light, one bit per
+  // level and set where the second child is taken.
+  std::unordered_map<const Light*, std::uint64_t> lightToBitTrail;
+};
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <unordered_map>
+#include <nanopt/core/lightsampler.h>
+#include <nanopt/core/distribution1d.h>
+
+namespace nanopt {
+
+// Picks lights in proportion to the luminance of their emitted power,
+// falling back to uniform selection when none of them has any.
+class PowerLightSampler : public LightSampler {
+public:
+  explicit PowerLightSampler(const std::vector<Light*>& lights);
+
+  const Light* sample(const Interaction& ref, float u, float& pmf) const override {
+    if (lights.empty()) return nullptr;
+    auto index = distribution.sampleDiscrete(u, pmf);
+    return lights[index];
+  }
+
+  float pmf(const Interaction& ref, const Light& light) const override {
+    auto it = lightIndices.find(&light);
+    return it == lightIndices.end() ? 0 : distribution.discretePdf(it->second);
+  }
+
+public:
+  std::vector<Light*> lights;
+  Distribution1D distribution;
+  std::unordered_map<const Light*, int> lightIndices;
+};
+
+}
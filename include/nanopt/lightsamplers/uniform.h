@@ -0,0 +1,28 @@
+#pragma once
+
+#include <nanopt/core/lightsampler.h>
+
+namespace nanopt {
+
+class UniformLightSampler : public LightSampler {
+public:
+  explicit UniformLightSampler(const std::vector<Light*>& lights) noexcept
+    : lights(lights)
+  { }
+
+  const Light* sample(const Interaction& ref, float u, float& pmf) const override {
+    auto nLights = lights.size();
+    if (!nLights) return nullptr;
+    pmf = 1.0f / nLights;
+    return lights[std::min((std::size_t)(u * nLights), nLights - 1)];
+  }
+
+  float pmf(const Interaction& ref, const Light& light) const override {
+    return lights.empty() ? 0 : 1.0f / lights.size();
+  }
+
+public:
+  std::vector<Light*> lights;
+};
+
+}
@@ -11,10 +11,10 @@ public:
     : kr(kr), kt(kt), eta(eta)
   { }
 
-  void computeScatteringFunctions(Interaction& isect) const override {
+  void computeScatteringFunctions(Interaction& isect, MemoryArena& arena) const override {
     if (kr.isBlack() && kt.isBlack()) return;
-    isect.bsdf = new BSDF(isect);
-    isect.bsdf->add(new FresnelSpecular(kr, kt, eta));
+    isect.bsdf = arena.create<BSDF>(isect);
+    isect.bsdf->add(arena.create<FresnelSpecular>(kr, kt, eta));
   }
 
 public:
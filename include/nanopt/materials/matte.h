@@ -10,10 +10,10 @@ public:
   explicit MatteMaterial(const Spectrum& kd) noexcept : kd(kd)
   { }
 
-  void computeScatteringFunctions(Interaction& isect) const override {
+  void computeScatteringFunctions(Interaction& isect, MemoryArena& arena) const override {
     if (kd.isBlack()) return;
-    isect.bsdf = new BSDF(isect);
-    isect.bsdf->add(new Diffuse(kd));
+    isect.bsdf = arena.create<BSDF>(isect);
+    isect.bsdf->add(arena.create<Diffuse>(kd));
   }
 
 public:
@@ -10,10 +10,10 @@ public:
   explicit MirrorMaterial(const Spectrum& kr) noexcept : kr(kr)
   { }
 
-  void computeScatteringFunctions(Interaction& isect) const override {
+  void computeScatteringFunctions(Interaction& isect, MemoryArena& arena) const override {
     if (kr.isBlack()) return;
-    isect.bsdf = new BSDF(isect);
-    isect.bsdf->add(new Mirror(kr));
+    isect.bsdf = arena.create<BSDF>(isect);
+    isect.bsdf->add(arena.create<Mirror>(kr));
   }
 
 public:
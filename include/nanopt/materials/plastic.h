@@ -18,16 +18,16 @@ public:
   ) noexcept : kd(kd), ks(ks), roughness(roughness), remapRoughness(remapRoughnes)
   { }
 
-  void computeScatteringFunctions(Interaction& isect) const override {
+  void computeScatteringFunctions(Interaction& isect, MemoryArena& arena) const override {
     if (kd.isBlack() && ks.isBlack()) return;
-    isect.bsdf = new BSDF(isect);
+    isect.bsdf = arena.create<BSDF>(isect);
     if (!kd.isBlack())
-      isect.bsdf->add(new Diffuse(kd));
+      isect.bsdf->add(arena.create<Diffuse>(kd));
     if (!ks.isBlack()) {
-      auto fresnel = new FresnelDielectric(1 / 1.5f);
+      auto fresnel = arena.create<FresnelDielectric>(1 / 1.5f);
       auto rough = remapRoughness ? BeckmannDistribution::roughnessToAlpha(roughness) : roughness;
-      auto distribution = new BeckmannDistribution(rough, rough);
-      isect.bsdf->add(new MicrofacetReflection(ks, fresnel, distribution));
+      auto distribution = arena.create<BeckmannDistribution>(rough, rough);
+      isect.bsdf->add(arena.create<MicrofacetReflection>(ks, fresnel, distribution));
     }
   }
 
@@ -12,6 +12,7 @@ constexpr float Inv4Pi      = 0.07957747154594766788f;
 constexpr float PiOver2     = 1.57079632679489661923f;
 constexpr float PiOver4     = 0.78539816339744830961f;
 constexpr float Sqrt2       = 1.41421356237309504880f;
+constexpr float OneMinusEpsilon = 0x1.fffffep-1f;
 
 constexpr float radians(float deg) {
   return Pi / 180 * deg;
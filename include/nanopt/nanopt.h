@@ -4,12 +4,29 @@
 #include <nanopt/core/parallel.h>
 #include <nanopt/cameras/perspective.h>
 
+#include <nanopt/filters/box.h>
+#include <nanopt/filters/gaussian.h>
+#include <nanopt/filters/mitchell.h>
+#include <nanopt/filters/blackmanharris.h>
+
 #include <nanopt/integrators/ao.h>
+#include <nanopt/integrators/bdpt.h>
+#include <nanopt/integrators/guided.h>
+#include <nanopt/integrators/irradiancecache.h>
+#include <nanopt/integrators/lighttracing.h>
 #include <nanopt/integrators/normal.h>
 #include <nanopt/integrators/path.h>
+#include <nanopt/integrators/restir.h>
+#include <nanopt/integrators/sppm.h>
+#include <nanopt/integrators/wavefront.h>
 
 #include <nanopt/lights/point.h>
 #include <nanopt/lights/diffuse.h>
+#include <nanopt/lights/infinite.h>
+
+#include <nanopt/lightsamplers/uniform.h>
+#include <nanopt/lightsamplers/power.h>
+#include <nanopt/lightsamplers/bvh.h>
 
 #include <nanopt/materials/matte.h>
 #include <nanopt/materials/mirror.h>
@@ -20,5 +37,7 @@
 
 #include <nanopt/samplers/random.h>
 
+#include <nanopt/utils/denoiser.h>
+#include <nanopt/utils/imagemetrics.h>
 #include <nanopt/utils/objloader.h>
 #include <nanopt/utils/plyloader.h>
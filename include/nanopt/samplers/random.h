@@ -8,16 +8,17 @@ namespace nanopt {
 class RandomSampler : public Sampler {
 public:
   explicit RandomSampler(std::int64_t samplesPerPixel) noexcept
+    : RandomSampler(samplesPerPixel, std::random_device()())
+  { }
+
+  RandomSampler(std::int64_t samplesPerPixel, std::uint64_t seed) noexcept
     : Sampler(samplesPerPixel)
-    , device()
-    , generator(device())
+    , generator(seed)
     , distribution(0, 1)
   { }
 
   std::unique_ptr<Sampler> clone(int seed) const override {
-    auto sampler = new RandomSampler(samplesPerPixel);
-    sampler->generator.seed(seed);
-    return std::unique_ptr<Sampler>(sampler);
+    return std::make_unique<RandomSampler>(samplesPerPixel, seed);
   }
 
   float get1D() override {
@@ -32,7 +33,6 @@ public:
   }
 
 private:
-  std::random_device device;
   std::mt19937_64 generator;
   std::uniform_real_distribution<float> distribution;
 };
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <nanopt/core/film.h>
+
+namespace nanopt {
+
+struct DenoiserOptions {
+  // Each iteration doubles the filter footprint, five cover 61 pixels.
+  int iterations = 5;
+  // Tolerances of the edge stopping functions. Luminance differences are
+  // measured in standard deviations of the pixel estimate.
+  float sigmaLuminance = 4.0f;
+  float sigmaNormal = 0.3f;
+  float sigmaAlbedo = 0.1f;
+  float sigmaDepth = 0.05f;
+};
+
+// Edge-avoiding a-trous wavelet filter over the resolved film pixels.
+// Lighting is divided by the albedo AOV before filtering, and neighbors
+// are weighted by their normal, albedo and depth. Needs a film rendered
+// with AOVs enabled.
+void denoise(Film& film, const DenoiserOptions& options = DenoiserOptions());
+
+}
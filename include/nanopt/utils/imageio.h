@@ -2,6 +2,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include <nanopt/core/spectrum.h>
 
 namespace nanopt {
@@ -14,4 +15,24 @@ void writeImage(
   int width, int height, Spectrum* data
 );
 
+enum class ChannelType {
+  Half,
+  Float,
+  Uint
+};
+
+// One plane of width * height values, floats for Half and Float channels
+// and std::uint32_t for Uint channels.
+struct ImageChannel {
+  std::string name;
+  ChannelType type;
+  const void* data;
+};
+
+void writeImageEXR(
+  const std::string& filename,
+  int width, int height,
+  std::vector<ImageChannel> channels
+);
+
 }
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <nanopt/core/spectrum.h>
+
+namespace nanopt {
+
+// Error metrics of an image against a reference of the same size, both
+// stored row by row, for judging how far a render has converged.
+
+// Squared difference averaged over pixels and channels.
+double meanSquaredError(const Spectrum* image, const Spectrum* reference, int width, int height);
+
+// Squared difference divided by the squared reference plus epsilon, so
+// errors in dark regions count as much as in bright ones.
+double relativeMeanSquaredError(
+  const Spectrum* image, const Spectrum* reference,
+  int width, int height, float epsilon = 0.01f);
+
+// Mean structural similarity of the luminances, clamped to [0, 1] and
+// gamma encoded first to approximate what is seen on screen, over the
+// usual 11 by 11 Gaussian window. One for identical images.
+double structuralSimilarity(const Spectrum* image, const Spectrum* reference, int width, int height);
+
+}
@@ -1,6 +1,7 @@
 #include <memory>
 #include <atomic>
 #include <algorithm>
+#include <nanopt/core/stats.h>
 #include <nanopt/core/parallel.h>
 #include <nanopt/accelerators/bvh.h>
 
@@ -553,6 +554,8 @@ bool BVHAccel::intersect(const Ray& ray, Interaction& isect) const {
   const int dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
 
   auto hit = false;
+  auto nodesVisited = 0;
+  auto triangleTests = 0;
   int nodesToVisit[64];
   nodesToVisit[0] = 0;
   int currentIndex, toVisitOffset = 0;
@@ -560,8 +563,10 @@ bool BVHAccel::intersect(const Ray& ray, Interaction& isect) const {
   while (toVisitOffset != -1) {
     currentIndex = nodesToVisit[toVisitOffset--];
     auto& node = nodes[currentIndex];
+    ++nodesVisited;
     if (node.bounds.intersect(ray, invDir, dirIsNeg)) {
       if (node.nPrims) {
+        triangleTests += node.nPrims;
         for (auto i = 0; i < node.nPrims; ++i) {
           auto& tri = triangles[node.primsOffset + i];
           if (tri.intersect(ray, isect)) {
@@ -581,8 +586,13 @@ bool BVHAccel::intersect(const Ray& ray, Interaction& isect) const {
     }
   }
 
+  NANOPT_STAT_INC(IntersectionRays);
+  NANOPT_STAT_ADD(BVHNodesVisited, nodesVisited);
+  NANOPT_STAT_ADD(TriangleTests, triangleTests);
+
   if (hit) {
     isect.triangle->computeIntersection(isect);
+    isect.primitiveId = (int)(isect.triangle - triangles.data());
     isect.wo = -ray.d;
   }
 
@@ -593,18 +603,23 @@ bool BVHAccel::intersect(const Ray& ray) const {
   Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
   const int dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
 
+  auto nodesVisited = 0;
+  auto triangleTests = 0;
   int nodesToVisit[64];
   nodesToVisit[0] = 0;
   int currentIndex, toVisitOffset = 0;
+  auto hit = false;
 
-  while (toVisitOffset != -1) {
+  while (toVisitOffset != -1 && !hit) {
     currentIndex = nodesToVisit[toVisitOffset--];
     auto& node = nodes[currentIndex];
+    ++nodesVisited;
     if (node.bounds.intersect(ray, invDir, dirIsNeg)) {
       if (node.nPrims) {
-        for (auto i = 0; i < node.nPrims; ++i)
-          if (triangles[node.primsOffset + i].intersect(ray))
-            return true;
+        for (auto i = 0; i < node.nPrims && !hit; ++i) {
+          ++triangleTests;
+          hit = triangles[node.primsOffset + i].intersect(ray);
+        }
       } else {
         if (dirIsNeg[node.splitAxis]) {
           nodesToVisit[++toVisitOffset] = currentIndex + 1;
@@ -617,7 +632,89 @@ bool BVHAccel::intersect(const Ray& ray) const {
     }
   }
 
-  return false;
+  NANOPT_STAT_INC(ShadowRays);
+  NANOPT_STAT_ADD(BVHNodesVisited, nodesVisited);
+  NANOPT_STAT_ADD(TriangleTests, triangleTests);
+
+  return hit;
+}
+
+void BVHAccel::occludedStream(const Ray* rays, int n, bool* occluded) const {
+  for (auto beg = 0; beg < n; beg += 64)
+    occludedPacket(rays + beg, std::min(64, n - beg), occluded + beg);
+}
+
+void BVHAccel::occludedPacket(const Ray* rays, int n, bool* occluded) const {
+  Vector3f invDir[64];
+  int dirIsNeg[64][3];
+  for (auto i = 0; i < n; ++i) {
+    invDir[i] = Vector3f(1 / rays[i].d.x, 1 / rays[i].d.y, 1 / rays[i].d.z);
+    for (auto axis = 0; axis < 3; ++axis)
+      dirIsNeg[i][axis] = invDir[i][axis] < 0;
+    occluded[i] = false;
+  }
+
+  // Every entry carries the rays still to be tested against the node,
+  // rays leaving the packet as soon as they are found occluded.
+  auto nodesVisited = 0;
+  auto triangleTests = 0;
+  int nodesToVisit[64];
+  std::uint64_t activeToVisit[64];
+  nodesToVisit[0] = 0;
+  activeToVisit[0] = n == 64 ? ~0ull : (1ull << n) - 1;
+  std::uint64_t hits = 0;
+  auto toVisitOffset = 0;
+
+  while (toVisitOffset != -1) {
+    auto currentIndex = nodesToVisit[toVisitOffset];
+    auto candidates = activeToVisit[toVisitOffset--] & ~hits;
+    if (!candidates) continue;
+    auto& node = nodes[currentIndex];
+    ++nodesVisited;
+
+    std::uint64_t active = 0;
+    for (auto bits = candidates; bits; bits &= bits - 1) {
+      auto i = __builtin_ctzll(bits);
+      if (node.bounds.intersect(rays[i], invDir[i], dirIsNeg[i]))
+        active |= 1ull << i;
+    }
+    if (!active) continue;
+
+    if (node.nPrims) {
+      for (auto bits = active; bits; bits &= bits - 1) {
+        auto i = __builtin_ctzll(bits);
+        for (auto j = 0; j < node.nPrims; ++j) {
+          ++triangleTests;
+          if (triangles[node.primsOffset + j].intersect(rays[i])) {
+            hits |= 1ull << i;
+            break;
+          }
+        }
+      }
+    } else {
+      // Near child first for the first active ray, which in a coherent
+      // packet is near for the others too.
+      auto first = __builtin_ctzll(active);
+      if (dirIsNeg[first][node.splitAxis]) {
+        nodesToVisit[++toVisitOffset] = currentIndex + 1;
+        activeToVisit[toVisitOffset] = active;
+        nodesToVisit[++toVisitOffset] = node.rightChild;
+        activeToVisit[toVisitOffset] = active;
+      } else {
+        nodesToVisit[++toVisitOffset] = node.rightChild;
+        activeToVisit[toVisitOffset] = active;
+        nodesToVisit[++toVisitOffset] = currentIndex + 1;
+        activeToVisit[toVisitOffset] = active;
+      }
+    }
+  }
+
+  for (auto bits = hits; bits; bits &= bits - 1)
+    occluded[__builtin_ctzll(bits)] = true;
+
+  NANOPT_STAT_ADD(ShadowRays, n);
+  NANOPT_STAT_ADD(BVHNodesVisited, nodesVisited);
+  NANOPT_STAT_ADD(TriangleTests, triangleTests);
 }
 
 }
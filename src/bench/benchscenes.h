@@ -0,0 +1,165 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <functional>
+#include <nanopt/nanopt.h>
+
+// Scenes shared by the benchmarks, set up as in their examples. They load
+// their assets relative to the working directory, like the examples do.
+
+namespace nanopt {
+
+struct BenchScene {
+  std::vector<std::unique_ptr<Mesh>> meshes;
+  std::vector<std::unique_ptr<Material>> materials;
+  // Emitter triangles the area lights point to, moving the outer vector
+  // leaves the triangles where they are.
+  std::vector<std::vector<Triangle>> emitters;
+  std::vector<Triangle> triangles;
+  std::vector<Light*> lights;
+  std::unique_ptr<BVHAccel> accel;
+  std::unique_ptr<Scene> scene;
+  Vector2i resolution;
+  std::function<std::unique_ptr<Camera>(Film& film)> camera;
+  int maxDepth = 5;
+
+  void addMesh(Mesh&& mesh, std::unique_ptr<Material> material) {
+    meshes.emplace_back(new Mesh(std::move(mesh)));
+    auto meshTriangles = createTriangleMesh(*meshes.back(), material.get());
+    triangles.insert(triangles.end(), meshTriangles.begin(), meshTriangles.end());
+    materials.push_back(std::move(material));
+  }
+
+  void addEmitter(Mesh&& mesh, const Spectrum& intensity, bool twoSided = false) {
+    meshes.emplace_back(new Mesh(std::move(mesh)));
+    emitters.push_back(createTriangleMesh(*meshes.back()));
+    for (auto& triangle : emitters.back())
+      lights.push_back(new DiffuseAreaLight(&triangle, intensity, twoSided));
+    triangles.insert(triangles.end(), emitters.back().begin(), emitters.back().end());
+  }
+
+  void build() {
+    accel = std::make_unique<BVHAccel>(std::move(triangles));
+    scene = std::make_unique<Scene>(*accel, std::move(lights));
+  }
+};
+
+inline Mesh smooth(Mesh&& mesh) {
+  mesh.shadingMode = ShadingMode::Smooth;
+  return std::move(mesh);
+}
+
+inline void buildCornellBox(BenchScene& s) {
+  s.addMesh(loadMeshOBJ("../scenes/cbox/walls.obj"), std::make_unique<MatteMaterial>(Spectrum(0.725, 0.71, 0.68)));
+  s.addMesh(loadMeshOBJ("../scenes/cbox/rightwall.obj"), std::make_unique<MatteMaterial>(Spectrum(0.161, 0.133, 0.427)));
+  s.addMesh(loadMeshOBJ("../scenes/cbox/leftwall.obj"), std::make_unique<MatteMaterial>(Spectrum(0.630, 0.065, 0.05)));
+  s.addMesh(smooth(loadMeshOBJ("../scenes/cbox/sphere1.obj")), std::make_unique<MirrorMaterial>(Spectrum(1.0f)));
+  s.addMesh(
+    smooth(loadMeshOBJ("../scenes/cbox/sphere2.obj")),
+    std::make_unique<GlassMaterial>(Spectrum(1), Spectrum(1), 1.4f));
+  s.addEmitter(loadMeshOBJ("../scenes/cbox/light.obj"), Spectrum(40));
+  s.build();
+
+  s.resolution = Vector2i(800, 600);
+  s.maxDepth = 10;
+  s.camera = [](Film& film) -> std::unique_ptr<Camera> {
+    return std::make_unique<PerspectiveCamera>(
+      Matrix4::scale(-1, 1, 1) *
+      Matrix4::lookAt(
+        Vector3f(0, 0.919769, -5.41159),
+        Vector3f(0, 0.893051, -4.41198),
+        Vector3f(0, 1, 0)
+      ),
+      film,
+      Bounds2f(Vector2f(-1, -0.75), Vector2f(1, 0.75)),
+      27.7856
+    );
+  };
+}
+
+inline void buildVeachMIS(BenchScene& s) {
+  auto sphere = loadMeshOBJ("../scenes/veach_mi/sphere.obj");
+  s.addEmitter(Mesh(Matrix4::translate(-1.25f, 0, 0) * Matrix4::scale(0.1f, 0.1f, 0.1f), sphere), Spectrum(100));
+  s.addEmitter(Mesh(Matrix4::translate(-3.75f, 0, 0) * Matrix4::scale(0.0333f, 0.0333f, 0.0333f), sphere), Spectrum(901.803f));
+  s.addEmitter(Mesh(Matrix4::translate(1.25f, 0, 0) * Matrix4::scale(0.3f, 0.3f, 0.3f), sphere), Spectrum(11.1111f));
+  s.addEmitter(Mesh(Matrix4::translate(3.75f, 0, 0) * Matrix4::scale(0.9f, 0.9f, 0.9f), sphere), Spectrum(1.23457f));
+  s.addEmitter(Mesh(Matrix4::translate(0, 4, -3), sphere), Spectrum(100.0f));
+
+  const char* plates[] = { "plate1", "plate2", "plate3", "plate4" };
+  const float roughness[] = { 0.005f, 0.02f, 0.05f, 0.1f };
+  for (auto i = 0; i < 4; ++i) {
+    auto material = std::make_unique<PlasticMaterial>(
+      Spectrum(0.0175f, 0.0225f, 0.0325f),
+      Spectrum(0.9675f),
+      roughness[i], false
+    );
+    s.addMesh(loadMeshOBJ(std::string("../scenes/veach_mi/") + plates[i] + ".obj"), std::move(material));
+  }
+  s.addMesh(loadMeshOBJ("../scenes/veach_mi/floor.obj"), std::make_unique<MatteMaterial>(Spectrum(0.1f)));
+  s.build();
+
+  s.resolution = Vector2i(768, 512);
+  s.camera = [](Film& film) -> std::unique_ptr<Camera> {
+    auto ratio = 512 / 768.f;
+    return std::make_unique<PerspectiveCamera>(
+      Matrix4::lookAt(
+        Vector3f(0, 6, -27.5),
+        Vector3f(0, -1.5, -2.5),
+        Vector3f(0, 1, 0)
+      ),
+      film,
+      Bounds2f(Vector2f(-1, -ratio), Vector2f(1, ratio)),
+      25
+    );
+  };
+}
+
+inline void buildTable(BenchScene& s) {
+  auto mesh = loadMeshOBJ("../scenes/table/mesh_1.obj");
+  s.addEmitter(Mesh(Matrix4::translate(10, 0, -25) * Matrix4::scale(0.06, 0.06, -1), mesh), Spectrum(3, 3, 2.5), true);
+  s.addEmitter(Mesh(Matrix4::translate(0, 0, -60) * Matrix4::scale(0.3, 0.3, -1), mesh), Spectrum(1, 1, 1.6), true);
+  s.addMesh(
+    Mesh(Matrix4::translate(3, 0, 0), loadMeshOBJ("../scenes/table/mesh_0.obj")),
+    std::make_unique<MatteMaterial>(Spectrum(0.2)));
+  s.addMesh(
+    Mesh(Matrix4::translate(-35, 25, 0) * Matrix4::scale(0.2, 0.35, 0.5), mesh),
+    std::make_unique<MatteMaterial>(Spectrum(0.5)));
+
+  const char* glasses[] = { "mesh_2", "mesh_3", "mesh_4" };
+  const float eta[] = { 1.33f, 1.5f, 0.8866667f };
+  for (auto i = 0; i < 3; ++i) {
+    auto glass = Mesh(Matrix4::translate(-1, 0, 0), loadMeshOBJ(std::string("../scenes/table/") + glasses[i] + ".obj"));
+    s.addMesh(smooth(std::move(glass)), std::make_unique<GlassMaterial>(Spectrum(1), Spectrum(1), eta[i]));
+  }
+  s.build();
+
+  s.resolution = Vector2i(800, 600);
+  s.maxDepth = 20;
+  s.camera = [](Film& film) -> std::unique_ptr<Camera> {
+    return std::make_unique<PerspectiveCamera>(
+      Matrix4::lookAt(
+        Vector3f(32.1259, -68.0505, -36.597),
+        Vector3f(31.6866, -67.2776, -36.1392),
+        Vector3f(-0.22886, 0.39656, -0.889024)
+      ),
+      film,
+      Bounds2f(Vector2f(-1, -0.75), Vector2f(1, 0.75)),
+      35
+    );
+  };
+}
+
+// Builds cbox, mis or table into s.
+inline void buildBenchScene(const std::string& name, BenchScene& s) {
+  if (name == "cbox")
+    buildCornellBox(s);
+  else if (name == "mis")
+    buildVeachMIS(s);
+  else if (name == "table")
+    buildTable(s);
+  else
+    throw std::runtime_error("Unknown scene \"" + name + "\"");
+}
+
+}
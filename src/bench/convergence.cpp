@@ -0,0 +1,170 @@
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <fstream>
+#include <iostream>
+#include <nanopt/nanopt.h>
+#include "benchscenes.h"
+
+using namespace nanopt;
+
+// Equal time convergence benchmark. Renders scenes with one integrator at
+// increasing budgets and prints the error of each render against a high
+// sample count reference as CSV, one row per budget:
+//
+//   convergence [--integrator path] [--spp 4,16,64,256] [--seconds 5,10,20]
+//               [--reference-spp 4096] [scene...]
+//
+// The scenes are those of benchscenes.h. The reference of a scene is read
+// from <scene>-reference.exr in the working directory, and rendered there
+// with the path tracer when missing.
+
+namespace {
+
+std::unique_ptr<Integrator> createIntegrator(
+    const std::string& name,
+    const Camera& camera, Sampler& sampler, int maxDepth) {
+
+  if (name == "path")
+    return std::make_unique<PathIntegrator>(camera, sampler, maxDepth);
+  if (name == "wavefront")
+    return std::make_unique<WavefrontPathIntegrator>(camera, sampler, maxDepth);
+  if (name == "bdpt")
+    return std::make_unique<BDPTIntegrator>(camera, sampler, maxDepth);
+  if (name == "lighttracing")
+    return std::make_unique<LightTracingIntegrator>(camera, sampler, maxDepth);
+  if (name == "sppm")
+    return std::make_unique<SPPMIntegrator>(camera, sampler, maxDepth);
+  if (name == "guided")
+    return std::make_unique<GuidedPathIntegrator>(camera, sampler, maxDepth);
+  if (name == "irradiancecache")
+    return std::make_unique<IrradianceCacheIntegrator>(camera, sampler, maxDepth);
+  // Direct lighting only, so its error includes the missing indirect.
+  if (name == "restir")
+    return std::make_unique<ReSTIRDirectIntegrator>(camera, sampler);
+  throw std::runtime_error("Unknown integrator \"" + name + "\"");
+}
+
+std::vector<float> parseList(const std::string& s) {
+  std::vector<float> values;
+  std::stringstream stream(s);
+  std::string value;
+  while (std::getline(stream, value, ','))
+    values.push_back(std::stof(value));
+  return values;
+}
+
+bool fileExists(const std::string& filename) {
+  return std::ifstream(filename).good();
+}
+
+std::unique_ptr<Spectrum[]> loadReference(const std::string& name, BenchScene& s, int spp) {
+  auto filename = name + "-reference.exr";
+  if (fileExists(filename)) {
+    int width, height;
+    auto reference = readImage(filename, width, height);
+    if (width == s.resolution.x && height == s.resolution.y)
+      return reference;
+    std::cerr << filename << " does not match the film, rendering it again" << std::endl;
+  }
+
+  std::cerr << "Rendering " << filename << " at " << spp << " spp" << std::endl;
+  Film film(s.resolution);
+  auto camera = s.camera(film);
+  RandomSampler sampler(spp);
+  PathIntegrator integrator(*camera, sampler, s.maxDepth);
+  integrator.options.samplesPerPass = 16;
+  integrator.options.printStats = false;
+  integrator.render(*s.scene);
+  film.writeImage(filename);
+
+  auto nPixels = s.resolution.x * s.resolution.y;
+  std::unique_ptr<Spectrum[]> reference(new Spectrum[nPixels]);
+  std::copy(film.pixels.get(), film.pixels.get() + nPixels, reference.get());
+  return reference;
+}
+
+// Samples per pixel the film took, averaged over its pixels.
+double averageSamples(const Film& film) {
+  auto nPixels = film.pixelBounds.area();
+  std::int64_t sum = 0;
+  for (auto i = 0; i < nPixels; ++i)
+    sum += film.accum[i].nSamples;
+  return (double)sum / nPixels;
+}
+
+}
+
+int main(int argc, char** argv) {
+  std::string integratorName = "path";
+  std::vector<float> sppBudgets;
+  std::vector<float> timeBudgets;
+  auto referenceSpp = 4096;
+  std::vector<std::string> sceneNames;
+  for (auto i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc)
+        throw std::runtime_error("Missing value for " + arg);
+      return argv[++i];
+    };
+    if (arg == "--integrator") integratorName = value();
+    else if (arg == "--spp") sppBudgets = parseList(value());
+    else if (arg == "--seconds") timeBudgets = parseList(value());
+    else if (arg == "--reference-spp") referenceSpp = std::stoi(value());
+    else sceneNames.push_back(arg);
+  }
+  if (sppBudgets.empty() && timeBudgets.empty())
+    timeBudgets = { 5, 10, 20, 40 };
+  if (sceneNames.empty())
+    sceneNames = { "cbox", "mis", "table" };
+
+  parallelInit();
+  std::cout << "scene,integrator,budget,spp,seconds,mse,relmse,ssim" << std::endl;
+  for (auto& name : sceneNames) {
+    BenchScene s;
+    buildBenchScene(name, s);
+    auto reference = loadReference(name, s, referenceSpp);
+
+    auto run = [&](const std::string& budget, int spp, float seconds) {
+      Film film(s.resolution);
+      auto camera = s.camera(film);
+      RandomSampler sampler(spp);
+      auto integrator = createIntegrator(integratorName, *camera, sampler, s.maxDepth);
+      integrator->options.printStats = false;
+      if (seconds > 0) {
+        // Passes of one sample stop the render close to the budget.
+        integrator->options.timeLimit = seconds;
+        integrator->options.samplesPerPass = 1;
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      integrator->render(*s.scene);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      auto image = film.pixels.get();
+      auto w = s.resolution.x, h = s.resolution.y;
+      std::printf(
+        "%s,%s,%s,%.1f,%.3f,%.6g,%.6g,%.6f\n",
+        name.c_str(), integratorName.c_str(), budget.c_str(),
+        averageSamples(film), elapsed.count(),
+        meanSquaredError(image, reference.get(), w, h),
+        relativeMeanSquaredError(image, reference.get(), w, h),
+        structuralSimilarity(image, reference.get(), w, h));
+      std::fflush(stdout);
+    };
+
+    for (auto spp : sppBudgets)
+      run(std::to_string((int)spp) + "spp", (int)spp, 0);
+    // The sample count only has to outlast the budget.
+    for (auto seconds : timeBudgets) {
+      std::ostringstream budget;
+      budget << seconds << "s";
+      run(budget.str(), 1 << 14, seconds);
+    }
+  }
+  parallelCleanup();
+
+  return 0;
+}
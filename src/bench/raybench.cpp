@@ -0,0 +1,182 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <nanopt/nanopt.h>
+#include "benchscenes.h"
+
+using namespace nanopt;
+
+// Ray throughput benchmark. Traces fixed sets of rays through the BVH of a
+// scene, with no shading at all, and prints the rate of each query at each
+// thread count as CSV:
+//
+//   raybench [--threads 1,2,4,8] [--repeat 5] [scene...]
+//
+// The sets are camera rays through every pixel center, cosine distributed
+// bounce rays off their first hits and shadow rays from those hits to
+// points on the emitters, drawn from fixed seeds so every run traces the
+// same rays and finds the same hit counts. Closest hit queries find the
+// nearest intersection, occlusion queries stop at any, one ray at a time
+// and through occludedStream. The fastest of the repeated runs is kept.
+
+namespace {
+
+constexpr auto ChunkSize = 1024;
+
+struct RaySet {
+  const char* name;
+  std::vector<Ray> rays;
+};
+
+std::vector<RaySet> generateRays(const BenchScene& s, const Camera& camera) {
+  RaySet primary { "primary", {} };
+  RaySet diffuse { "diffuse", {} };
+  RaySet shadow { "shadow", {} };
+  RandomSampler sampler(1, 1);
+
+  auto& lights = s.scene->lights;
+  for (auto y = 0; y < s.resolution.y; ++y) {
+    for (auto x = 0; x < s.resolution.x; ++x) {
+      auto ray = camera.generateRay({ Vector2f(x + 0.5f, y + 0.5f) });
+      primary.rays.push_back(ray);
+
+      // Draw every sample up front so a miss does not shift the
+      // samples of the pixels after it.
+      auto uBounce = sampler.get2D();
+      auto uLight = sampler.get1D();
+      auto uPoint = sampler.get2D();
+      Interaction isect;
+      if (!s.scene->intersect(ray, isect)) continue;
+
+      Frame frame(faceForward(isect.n, isect.wo));
+      diffuse.rays.push_back(isect.spawnRay(frame.toWorld(consineSampleHemisphere(uBounce))));
+
+      if (lights.empty()) continue;
+      auto light = lights[std::min((int)(uLight * lights.size()), (int)lights.size() - 1)];
+      Interaction pLight;
+      float pdf;
+      if (light->samplePoint(uPoint, pLight, pdf) && pdf > 0)
+        shadow.rays.push_back(isect.spawnRayTo(pLight.p));
+    }
+  }
+  return { primary, diffuse, shadow };
+}
+
+// Traces the rays in chunks spread over the thread pool and returns the
+// seconds the fastest of repeat runs took. query traces n rays and
+// returns how many of them hit.
+template <typename Query>
+double measure(const std::vector<Ray>& rays, int repeat, std::int64_t& hits, Query query) {
+  auto nChunks = ((std::int64_t)rays.size() + ChunkSize - 1) / ChunkSize;
+  std::vector<std::int64_t> chunkHits(nChunks);
+  double best = Infinity;
+  for (auto run = 0; run < repeat; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    parallelFor([&](std::int64_t chunk) {
+      auto begin = chunk * ChunkSize;
+      auto n = (int)std::min<std::int64_t>(ChunkSize, rays.size() - begin);
+      chunkHits[chunk] = query(rays.data() + begin, n);
+    }, nChunks);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  hits = 0;
+  for (auto h : chunkHits)
+    hits += h;
+  return best;
+}
+
+std::vector<int> parseList(const std::string& s) {
+  std::vector<int> values;
+  std::stringstream stream(s);
+  std::string value;
+  while (std::getline(stream, value, ','))
+    values.push_back(std::stoi(value));
+  return values;
+}
+
+}
+
+int main(int argc, char** argv) {
+  std::vector<int> threadCounts;
+  auto repeat = 5;
+  std::vector<std::string> sceneNames;
+  for (auto i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc)
+        throw std::runtime_error("Missing value for " + arg);
+      return argv[++i];
+    };
+    if (arg == "--threads") threadCounts = parseList(value());
+    else if (arg == "--repeat") repeat = std::stoi(value());
+    else sceneNames.push_back(arg);
+  }
+  if (threadCounts.empty()) {
+    // Powers of two up to every hardware thread.
+    auto maxThreads = (int)std::max(std::thread::hardware_concurrency(), 1u);
+    for (auto n = 1; n < maxThreads; n *= 2)
+      threadCounts.push_back(n);
+    threadCounts.push_back(maxThreads);
+  }
+  if (sceneNames.empty())
+    sceneNames = { "cbox", "mis", "table" };
+
+  std::cout << "scene,rays,query,threads,count,hits,seconds,mrays" << std::endl;
+  for (auto& name : sceneNames) {
+    BenchScene s;
+    buildBenchScene(name, s);
+    Film film(s.resolution);
+    auto camera = s.camera(film);
+    auto raySets = generateRays(s, *camera);
+    auto& accel = *s.accel;
+
+    for (auto nThreads : threadCounts) {
+      parallelInit(nThreads);
+      for (auto& set : raySets) {
+        auto report = [&](const char* query, std::int64_t hits, double seconds) {
+          std::printf(
+            "%s,%s,%s,%d,%zu,%lld,%.6f,%.3f\n",
+            name.c_str(), set.name, query, nThreads, set.rays.size(),
+            (long long)hits, seconds, set.rays.size() / seconds * 1e-6);
+          std::fflush(stdout);
+        };
+
+        std::int64_t hits;
+        // Closest hits shorten tMax, so they trace copies.
+        auto seconds = measure(set.rays, repeat, hits, [&](const Ray* rays, int n) {
+          auto nHits = 0;
+          for (auto i = 0; i < n; ++i) {
+            auto ray = rays[i];
+            Interaction isect;
+            nHits += accel.intersect(ray, isect);
+          }
+          return nHits;
+        });
+        report("closest", hits, seconds);
+
+        seconds = measure(set.rays, repeat, hits, [&](const Ray* rays, int n) {
+          auto nHits = 0;
+          for (auto i = 0; i < n; ++i)
+            nHits += accel.intersect(rays[i]);
+          return nHits;
+        });
+        report("occluded", hits, seconds);
+
+        seconds = measure(set.rays, repeat, hits, [&](const Ray* rays, int n) {
+          bool occluded[ChunkSize];
+          accel.occludedStream(rays, n, occluded);
+          return (int)std::count(occluded, occluded + n, true);
+        });
+        report("occluded-stream", hits, seconds);
+      }
+      parallelCleanup();
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <nanopt/core/checkpoint.h>
+
+namespace nanopt {
+
+// Native byte order, checkpoints are meant to be resumed on the machine
+// type that wrote them.
+struct CheckpointHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::int32_t bounds[4];
+  std::int64_t samplesPerPixel;
+  std::int32_t samplesPerPass;
+  std::int32_t pixelSize;
+  // Zero when the film records no AOVs.
+  std::int32_t aovPixelSize;
+  std::int32_t pass;
+  std::int64_t samplesTaken;
+};
+
+static constexpr char CheckpointMagic[4] = { 'N', 'P', 'C', 'K' };
+static constexpr std::uint32_t CheckpointVersion = 3;
+
+static CheckpointHeader makeHeader(const Film& film, std::int64_t samplesPerPixel, int samplesPerPass) {
+  CheckpointHeader header = { };
+  std::memcpy(header.magic, CheckpointMagic, sizeof(header.magic));
+  header.version = CheckpointVersion;
+  header.bounds[0] = film.pixelBounds.pMin.x;
+  header.bounds[1] = film.pixelBounds.pMin.y;
+  header.bounds[2] = film.pixelBounds.pMax.x;
+  header.bounds[3] = film.pixelBounds.pMax.y;
+  header.samplesPerPixel = samplesPerPixel;
+  header.samplesPerPass = samplesPerPass;
+  header.pixelSize = sizeof(Film::Pixel);
+  header.aovPixelSize = film.aovs ? sizeof(Film::AOVPixel) : 0;
+  return header;
+}
+
+void writeCheckpoint(
+    const std::string& filename,
+    const Film& film,
+    std::int64_t samplesPerPixel,
+    int samplesPerPass,
+    const RenderCheckpoint& checkpoint) {
+
+  auto header = makeHeader(film, samplesPerPixel, samplesPerPass);
+  header.pass = checkpoint.pass;
+  header.samplesTaken = checkpoint.samplesTaken;
+
+  auto tmpFilename = filename + ".tmp";
+  {
+    std::ofstream file(tmpFilename, std::ios::binary);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)film.accum.get(), sizeof(Film::Pixel) * film.pixelBounds.area());
+    for (auto i = 0; i < film.pixelBounds.area(); ++i) {
+      float splat[3] = { film.splats[i].rgb[0], film.splats[i].rgb[1], film.splats[i].rgb[2] };
+      file.write((const char*)splat, sizeof(splat));
+    }
+    if (film.aovs)
+      file.write((const char*)film.aovs.get(), sizeof(Film::AOVPixel) * film.pixelBounds.area());
+    if (!file)
+      throw std::runtime_error("Unable to write checkpoint file: " + tmpFilename);
+  }
+  if (std::rename(tmpFilename.c_str(), filename.c_str()))
+    throw std::runtime_error("Unable to write checkpoint file: " + filename);
+}
+
+bool readCheckpoint(
+    const std::string& filename,
+    Film& film,
+    std::int64_t samplesPerPixel,
+    int samplesPerPass,
+    RenderCheckpoint& checkpoint) {
+
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) return false;
+
+  CheckpointHeader header;
+  auto expected = makeHeader(film, samplesPerPixel, samplesPerPass);
+  file.read((char*)&header, sizeof(header));
+  if (!file || std::memcmp(header.magic, expected.magic, sizeof(header.magic)))
+    throw std::runtime_error("Not a checkpoint file: " + filename);
+  if (header.version != expected.version ||
+      std::memcmp(header.bounds, expected.bounds, sizeof(header.bounds)) ||
+      header.samplesPerPixel != expected.samplesPerPixel ||
+      header.samplesPerPass != expected.samplesPerPass ||
+      header.pixelSize != expected.pixelSize ||
+      header.aovPixelSize != expected.aovPixelSize)
+    throw std::runtime_error("Checkpoint file does not match the render: " + filename);
+
+  file.read((char*)film.accum.get(), sizeof(Film::Pixel) * film.pixelBounds.area());
+  for (auto i = 0; i < film.pixelBounds.area(); ++i) {
+    float splat[3];
+    file.read((char*)splat, sizeof(splat));
+    for (auto c = 0; c < 3; ++c)
+      film.splats[i].rgb[c] = splat[c];
+  }
+  if (film.aovs)
+    file.read((char*)film.aovs.get(), sizeof(Film::AOVPixel) * film.pixelBounds.area());
+  if (!file)
+    throw std::runtime_error("Truncated checkpoint file: " + filename);
+
+  checkpoint.pass = header.pass;
+  checkpoint.samplesTaken = header.samplesTaken;
+  return true;
+}
+
+}
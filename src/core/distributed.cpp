@@ -0,0 +1,297 @@
+#include <csignal>
+#include <cstdio>
+#include <cerrno>
+#include <deque>
+#include <thread>
+#include <iostream>
+#include <stdexcept>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <nanopt/core/integrator.h>
+
+namespace nanopt {
+
+namespace {
+
+// Both ends run the same binary forked from one process, so messages are
+// sent as raw structs and pixels in native layout. A negative index asks
+// the worker to exit.
+struct RegionRequest {
+  std::int32_t index;
+  std::int32_t bounds[4];
+};
+
+// Followed by the film pixels of bounds, which covers the region grown by
+// the filter radius, the AOV pixels of the region when enabled and, for
+// integrators tracing light paths, the splats of the whole film, which
+// light paths from the region can land anywhere on.
+struct RegionResult {
+  std::int32_t index;
+  std::int32_t bounds[4];
+};
+
+bool sendAll(int fd, const void* data, std::size_t size) {
+  auto p = (const char*)data;
+  while (size > 0) {
+    auto n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool receiveAll(int fd, void* data, std::size_t size) {
+  auto p = (char*)data;
+  while (size > 0) {
+    auto n = recv(fd, p, size, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+Bounds2i toBounds(const std::int32_t b[4]) {
+  return Bounds2i(Vector2i(b[0], b[1]), Vector2i(b[2], b[3]));
+}
+
+void fromBounds(const Bounds2i& bounds, std::int32_t b[4]) {
+  b[0] = bounds.pMin.x;
+  b[1] = bounds.pMin.y;
+  b[2] = bounds.pMax.x;
+  b[3] = bounds.pMax.y;
+}
+
+std::vector<Bounds2i> makeRegions(const Bounds2i& pixelBounds, int regionSize) {
+  std::vector<Bounds2i> regions;
+  for (auto y = pixelBounds.pMin.y; y < pixelBounds.pMax.y; y += regionSize)
+    for (auto x = pixelBounds.pMin.x; x < pixelBounds.pMax.x; x += regionSize)
+      regions.emplace_back(
+        Vector2i(x, y),
+        Vector2i(std::min(pixelBounds.pMax.x, x + regionSize), std::min(pixelBounds.pMax.y, y + regionSize)));
+  return regions;
+}
+
+struct Worker {
+  pid_t pid = -1;
+  int fd = -1;
+  // Region being rendered, negative while idle.
+  int region = -1;
+  bool alive = true;
+};
+
+}
+
+void Integrator::renderDistributed(const Scene& scene, const DistributedOptions& distributed) {
+  if (parallelThreadCount() > 1)
+    throw std::runtime_error("Distributed renders fork, they have to start before parallelInit.");
+
+  auto& film = camera.film;
+  auto nPixels = film.pixelBounds.area();
+  auto nWorkers = std::max(1, distributed.nWorkers);
+  auto nThreads = distributed.threadsPerWorker > 0
+    ? distributed.threadsPerWorker
+    : std::max(1, (int)std::thread::hardware_concurrency() / nWorkers);
+  auto regions = makeRegions(film.pixelBounds, std::max(1, distributed.regionSize));
+  auto nRegions = (int)regions.size();
+
+  film.clear();
+  std::cout.flush();
+  std::fflush(stdout);
+
+  std::vector<Worker> workers(nWorkers);
+  for (auto i = 0; i < nWorkers; ++i) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+      throw std::runtime_error("Unable to create worker socket.");
+
+    auto pid = fork();
+    if (pid < 0)
+      throw std::runtime_error("Unable to fork worker process.");
+
+    if (pid == 0) {
+      close(fds[0]);
+      for (auto j = 0; j < i; ++j)
+        close(workers[j].fd);
+
+      auto status = 0;
+      try {
+        options.snapshotFilename.clear();
+        options.checkpointFilename.clear();
+        options.tileLogFilename.clear();
+        options.printStats = false;
+        parallelInit(nThreads);
+
+        RegionRequest request;
+        while (receiveAll(fds[1], &request, sizeof(request)) && request.index >= 0) {
+          options.region = toBounds(request.bounds);
+          render(scene);
+
+          auto tile = film.getFilmTile(options.region);
+          auto j = 0;
+          for (auto p : tile.pixelBounds)
+            tile.pixels[j++] = film.accum[film.pixelIndex(p)];
+
+          RegionResult result;
+          result.index = request.index;
+          fromBounds(tile.pixelBounds, result.bounds);
+          auto ok = sendAll(fds[1], &result, sizeof(result)) &&
+            sendAll(fds[1], tile.pixels.data(), sizeof(Film::Pixel) * tile.pixels.size());
+          for (auto p : options.region) {
+            if (!ok || !film.aovs) break;
+            ok = sendAll(fds[1], &film.aovs[film.pixelIndex(p)], sizeof(Film::AOVPixel));
+          }
+          if (ok && tracesLightPaths) {
+            std::vector<float> splats(nPixels * 3);
+            for (auto j = 0; j < nPixels * 3; ++j)
+              splats[j] = film.splats[j / 3].rgb[j % 3];
+            ok = sendAll(fds[1], splats.data(), sizeof(float) * splats.size());
+          }
+          if (!ok) break;
+        }
+        parallelCleanup();
+      } catch (const std::exception& e) {
+        std::cerr << "Worker failed: " << e.what() << std::endl;
+        status = 1;
+      } catch (...) {
+        status = 1;
+      }
+      std::cout.flush();
+      _exit(status);
+    }
+
+    close(fds[1]);
+    workers[i].pid = pid;
+    workers[i].fd = fds[0];
+  }
+
+  std::deque<int> pending;
+  for (auto i = 0; i < nRegions; ++i)
+    pending.push_back(i);
+  std::vector<char> finished(nRegions, false);
+  std::vector<int> copies(nRegions, 0);
+  auto nFinished = 0;
+  // Regions overlap by the filter radius, merging them in a fixed order
+  // keeps the sums of the pixels they share from depending on timing.
+  OrderedTileMerger merger(film, nRegions);
+  std::vector<float> splats(tracesLightPaths ? nPixels * 3 : 0);
+
+  // Hands the worker the next region, or once none are left a copy of the
+  // unfinished region the fewest workers are on.
+  auto assign = [&](Worker& worker) {
+    auto region = -1;
+    while (!pending.empty() && region < 0) {
+      region = pending.front();
+      pending.pop_front();
+      if (finished[region]) region = -1;
+    }
+    if (region < 0) {
+      for (auto i = 0; i < nRegions; ++i) {
+        if (finished[i] || copies[i] == 0) continue;
+        if (region < 0 || copies[i] < copies[region]) region = i;
+      }
+    }
+    if (region < 0) return;
+
+    RegionRequest request;
+    request.index = region;
+    fromBounds(regions[region], request.bounds);
+    if (!sendAll(worker.fd, &request, sizeof(request))) {
+      worker.alive = false;
+      if (copies[region] == 0) pending.push_front(region);
+      return;
+    }
+    worker.region = region;
+    ++copies[region];
+  };
+
+  // A worker that died gives its region back unless another copy of it is
+  // still in flight.
+  auto fail = [&](Worker& worker) {
+    worker.alive = false;
+    if (worker.region < 0) return;
+    if (--copies[worker.region] == 0 && !finished[worker.region])
+      pending.push_front(worker.region);
+    worker.region = -1;
+  };
+
+  while (nFinished < nRegions) {
+    for (auto& worker : workers)
+      if (worker.alive && worker.region < 0) assign(worker);
+
+    std::vector<pollfd> fds;
+    std::vector<Worker*> polled;
+    for (auto& worker : workers) {
+      if (!worker.alive || worker.region < 0) continue;
+      fds.push_back({ worker.fd, POLLIN, 0 });
+      polled.push_back(&worker);
+    }
+    if (fds.empty())
+      throw std::runtime_error("Every worker process failed.");
+
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("Unable to poll worker processes.");
+    }
+
+    for (auto i = 0; i < (int)fds.size(); ++i) {
+      if (!fds[i].revents) continue;
+      auto& worker = *polled[i];
+
+      RegionResult result;
+      if (!receiveAll(worker.fd, &result, sizeof(result)) || result.index != worker.region) {
+        fail(worker);
+        continue;
+      }
+      auto region = regions[result.index];
+      FilmTile tile(film, toBounds(result.bounds));
+      std::vector<Film::AOVPixel> aovs(film.aovs ? region.area() : 0);
+      if (!receiveAll(worker.fd, tile.pixels.data(), sizeof(Film::Pixel) * tile.pixels.size()) ||
+          !receiveAll(worker.fd, aovs.data(), sizeof(Film::AOVPixel) * aovs.size()) ||
+          !receiveAll(worker.fd, splats.data(), sizeof(float) * splats.size())) {
+        fail(worker);
+        continue;
+      }
+
+      --copies[result.index];
+      worker.region = -1;
+      if (finished[result.index]) continue;
+
+      merger.merge(result.index, std::move(tile));
+      auto j = 0;
+      for (auto p : region) {
+        if (aovs.empty()) break;
+        film.aovs[film.pixelIndex(p)] = aovs[j++];
+      }
+      for (j = 0; j < (int)splats.size(); ++j)
+        film.splats[j / 3].rgb[j % 3].add(splats[j]);
+      finished[result.index] = true;
+      ++nFinished;
+    }
+  }
+
+  // Workers still on a duplicate region are stopped rather than waited for.
+  for (auto& worker : workers) {
+    if (worker.alive && worker.region >= 0) {
+      kill(worker.pid, SIGTERM);
+    } else if (worker.alive) {
+      RegionRequest request = { -1, { 0, 0, 0, 0 } };
+      sendAll(worker.fd, &request, sizeof(request));
+    }
+    close(worker.fd);
+    waitpid(worker.pid, nullptr, 0);
+  }
+
+  // The merged film holds every region's samples, and with them the
+  // number of light paths the splats came from.
+  if (tracesLightPaths)
+    film.splatScale = film.lightPathSplatScale();
+  film.resolve();
+}
+
+}
@@ -1,11 +1,15 @@
 #include <nanopt/core/distribution1d.h>
+#include <nanopt/math/math.h>
 
 namespace nanopt {
 
 Distribution1D::Distribution1D(const float* func, int n) {
   this->n = n;
   sum = std::accumulate(func, func + n, 0.0f);
-  auto inv = 1 / sum;
+  // All zero functions, such as black rows of an environment map, sample
+  // uniformly rather than divide by zero, their zero sum still keeping
+  // them from being picked by a marginal.
+  auto inv = sum > 0 ? 1 / sum : 0;
 
   std::stack<float> low, high;
   p.reset(new float[n]);
@@ -13,16 +17,22 @@ Distribution1D::Distribution1D(const float* func, int n) {
   aliasIndex.reset(new int[n]);
 
   for (auto i = 0; i < n; ++i) {
-    p[i] = func[i] * inv;
-    aliasP[i] = func[i] * n;
+    p[i] = sum > 0 ? func[i] * inv : 1.0f / n;
+    aliasP[i] = p[i] * n;
+    aliasIndex[i] = i;
     if (aliasP[i] < 1) low.push(i);
     else if (aliasP[i] > 1) high.push(i);
   }
 
   while (!low.empty()) {
     auto l = low.top();
-    auto h = high.top();
     low.pop();
+    // Rounding can leave an entry just below one with no partner left.
+    if (high.empty()) {
+      aliasP[l] = 1;
+      continue;
+    }
+    auto h = high.top();
     aliasIndex[l] = h;
     aliasP[h] = aliasP[l] + aliasP[h] - 1;
     if (aliasP[h] == 1) high.pop();
@@ -31,12 +41,18 @@ Distribution1D::Distribution1D(const float* func, int n) {
       low.push(h);
     }
   }
+  // Entries rounding left above one keep themselves, like those at one.
+  while (!high.empty()) {
+    aliasP[high.top()] = 1;
+    high.pop();
+  }
 }
 
 float Distribution1D::sampleContinuous(float u, float& p, int& index) const {
   u *= n;
   index = std::min((int)u, n - 1);
-  auto uRemapped = u - index;
+  // u = 1 lands at the end of the last entry, which must not alias.
+  auto uRemapped = std::min(u - index, OneMinusEpsilon);
   if (uRemapped < aliasP[index]) {
     uRemapped /= aliasP[index];
   } else {
@@ -50,8 +66,8 @@ float Distribution1D::sampleContinuous(float u, float& p, int& index) const {
 int Distribution1D::sampleDiscrete(float u, float& p) const {
   u *= n;
   auto index = std::min((int)u, n - 1);
-  auto uRemapped = u - index;
-  if (uRemapped > aliasP[index])
+  auto uRemapped = std::min(u - index, OneMinusEpsilon);
+  if (uRemapped >= aliasP[index])
     index = aliasIndex[index];
   p = this->p[index];
   return index;
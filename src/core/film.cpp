@@ -0,0 +1,200 @@
+#include <nanopt/core/film.h>
+#include <nanopt/filters/box.h>
+
+namespace nanopt {
+
+Film::Film(
+    const Vector2i& resolution,
+    const Bounds2f& cropWindow,
+    std::unique_ptr<Filter> filter)
+  : resolution(resolution)
+  , pixelBounds(
+    Vector2i((int)std::ceil(resolution.x * cropWindow.pMin.x), (int)std::ceil(resolution.y * cropWindow.pMin.y)),
+    Vector2i((int)std::ceil(resolution.x * cropWindow.pMax.x), (int)std::ceil(resolution.y * cropWindow.pMax.y)))
+  , filter(filter ? std::move(filter) : std::make_unique<BoxFilter>())
+  , pixels(new Spectrum[pixelBounds.area()])
+  , accum(new Pixel[pixelBounds.area()])
+  , splats(new SplatPixel[pixelBounds.area()])
+{
+  auto radius = this->filter->radius;
+  for (auto i = 0; i < FilterTableSize; ++i)
+    filterTable[i] = this->filter->evaluate1D((i + 0.5f) / FilterTableSize * radius);
+  filterTableScale = FilterTableSize / radius;
+}
+
+void Film::clear() {
+  auto nPixels = pixelBounds.area();
+  for (auto i = 0; i < nPixels; ++i) {
+    accum[i] = Pixel();
+    pixels[i] = Spectrum(0);
+    for (auto& c : splats[i].rgb)
+      c = 0;
+    if (aovs) aovs[i] = AOVPixel();
+  }
+}
+
+void Film::enableAOVs() {
+  if (!aovs) aovs.reset(new AOVPixel[pixelBounds.area()]);
+}
+
+void Film::addAOVSample(const Vector2f& pFilm, const AOVSample& sample) {
+  Vector2i p((int)std::floor(pFilm.x), (int)std::floor(pFilm.y));
+  if (!aovs || !insideBounds(p)) return;
+  auto& pixel = aovs[pixelIndex(p)];
+  pixel.albedoSum += sample.albedo;
+  ++pixel.nSamples;
+  if (sample.primitiveId < 0) return;
+  pixel.normalSum += sample.normal;
+  pixel.depthSum += sample.depth;
+  if (pixel.nHits++ == 0)
+    pixel.primitiveId = sample.primitiveId;
+}
+
+void Film::addSample(const Vector2f& pFilm, const Spectrum& l) {
+  addSample(accum.get(), pixelBounds, pFilm, l);
+}
+
+void Film::addSample(Pixel* target, const Bounds2i& bounds, const Vector2f& pFilm, const Spectrum& l) const {
+  auto width = bounds.pMax.x - bounds.pMin.x;
+  Vector2i p((int)std::floor(pFilm.x), (int)std::floor(pFilm.y));
+  if (p.x >= bounds.pMin.x && p.x < bounds.pMax.x && p.y >= bounds.pMin.y && p.y < bounds.pMax.y) {
+    auto& pixel = target[(p.y - bounds.pMin.y) * width + (p.x - bounds.pMin.x)];
+    auto y = (double)l.y();
+    pixel.ySum += y;
+    pixel.ySquaredSum += y * y;
+    ++pixel.nSamples;
+  }
+
+  // Pixel centers sit at half integer raster positions.
+  auto radius = filter->radius;
+  auto dx = pFilm.x - 0.5f;
+  auto dy = pFilm.y - 0.5f;
+  auto x0 = std::max((int)std::ceil(dx - radius), bounds.pMin.x);
+  auto x1 = std::min((int)std::floor(dx + radius) + 1, bounds.pMax.x);
+  auto y0 = std::max((int)std::ceil(dy - radius), bounds.pMin.y);
+  auto y1 = std::min((int)std::floor(dy + radius) + 1, bounds.pMax.y);
+
+  for (auto y = y0; y < y1; ++y) {
+    auto wy = filterWeight(y - dy);
+    auto row = target + (y - bounds.pMin.y) * width - bounds.pMin.x;
+    for (auto x = x0; x < x1; ++x) {
+      auto w = wy * filterWeight(x - dx);
+      row[x].lSum += l * w;
+      row[x].weightSum += w;
+    }
+  }
+}
+
+FilmTile Film::getFilmTile(const Bounds2i& sampleBounds) const {
+  auto radius = filter->radius;
+  Vector2i p0(
+    std::max((int)std::ceil(sampleBounds.pMin.x - 0.5f - radius), pixelBounds.pMin.x),
+    std::max((int)std::ceil(sampleBounds.pMin.y - 0.5f - radius), pixelBounds.pMin.y));
+  Vector2i p1(
+    std::min((int)std::floor(sampleBounds.pMax.x - 0.5f + radius) + 1, pixelBounds.pMax.x),
+    std::min((int)std::floor(sampleBounds.pMax.y - 0.5f + radius) + 1, pixelBounds.pMax.y));
+  return FilmTile(*this, Bounds2i(p0, p1));
+}
+
+void Film::mergeFilmTile(const FilmTile& tile) {
+  std::lock_guard<std::mutex> lock(mergeMutex);
+  auto i = 0;
+  for (auto p : tile.pixelBounds) {
+    auto& src = tile.pixels[i++];
+    auto& dst = accum[pixelIndex(p)];
+    dst.lSum += src.lSum;
+    dst.weightSum += src.weightSum;
+    dst.ySum += src.ySum;
+    dst.ySquaredSum += src.ySquaredSum;
+    dst.nSamples += src.nSamples;
+  }
+}
+
+void OrderedTileMerger::merge(int index, FilmTile&& tile) {
+  std::lock_guard<std::mutex> lock(m);
+  tiles[index].reset(new FilmTile(std::move(tile)));
+  for (; next < (int)tiles.size() && tiles[next]; ++next) {
+    film.mergeFilmTile(*tiles[next]);
+    tiles[next].reset();
+  }
+}
+
+float Film::lightPathSplatScale() const {
+  std::int64_t nSamples = 0;
+  auto nPixels = pixelBounds.area();
+  for (auto i = 0; i < nPixels; ++i)
+    nSamples += accum[i].nSamples;
+  if (nSamples == 0) return 1;
+  return (float)((double)resolution.x * resolution.y / nSamples);
+}
+
+void Film::resolve(Spectrum* out) const {
+  auto nPixels = pixelBounds.area();
+  for (auto i = 0; i < nPixels; ++i) {
+    auto& pixel = accum[i];
+    auto& splat = splats[i];
+    out[i] = pixel.weightSum != 0 ? pixel.lSum / pixel.weightSum : Spectrum(0);
+    out[i] += Spectrum(splat.rgb[0], splat.rgb[1], splat.rgb[2]) * splatScale;
+  }
+}
+
+void Film::writeAOVs(const std::string& filename) const {
+  auto diag = pixelBounds.diag();
+  auto nPixels = pixelBounds.area();
+
+  std::vector<float> rgb[3];
+  std::vector<std::uint32_t> sampleCount(nPixels);
+  for (auto c = 0; c < 3; ++c) {
+    rgb[c].resize(nPixels);
+    for (auto i = 0; i < nPixels; ++i)
+      rgb[c][i] = pixels[i][c];
+  }
+  for (auto i = 0; i < nPixels; ++i)
+    sampleCount[i] = accum[i].nSamples;
+
+  std::vector<ImageChannel> channels = {
+    { "R", ChannelType::Half, rgb[0].data() },
+    { "G", ChannelType::Half, rgb[1].data() },
+    { "B", ChannelType::Half, rgb[2].data() },
+    { "sampleCount", ChannelType::Uint, sampleCount.data() }
+  };
+
+  std::vector<float> albedo[3], normal[3], depth;
+  std::vector<std::uint32_t> primitiveId;
+  if (aovs) {
+    for (auto c = 0; c < 3; ++c) {
+      albedo[c].resize(nPixels);
+      normal[c].resize(nPixels);
+    }
+    depth.resize(nPixels);
+    primitiveId.resize(nPixels);
+
+    for (auto i = 0; i < nPixels; ++i) {
+      auto& pixel = aovs[i];
+      auto a = pixel.nSamples ? pixel.albedoSum / (float)pixel.nSamples : Spectrum(0);
+      auto n = pixel.nHits ? pixel.normalSum / (float)pixel.nHits : Vector3f(0, 0, 0);
+      for (auto c = 0; c < 3; ++c) {
+        albedo[c][i] = a[c];
+        normal[c][i] = n[c];
+      }
+      depth[i] = pixel.nHits ? pixel.depthSum / pixel.nHits : Infinity;
+      // Pixels that saw no surface wrap around to the largest id.
+      primitiveId[i] = (std::uint32_t)pixel.primitiveId;
+    }
+
+    channels.insert(channels.end(), {
+      { "albedo.R", ChannelType::Half, albedo[0].data() },
+      { "albedo.G", ChannelType::Half, albedo[1].data() },
+      { "albedo.B", ChannelType::Half, albedo[2].data() },
+      { "N.X", ChannelType::Half, normal[0].data() },
+      { "N.Y", ChannelType::Half, normal[1].data() },
+      { "N.Z", ChannelType::Half, normal[2].data() },
+      { "Z", ChannelType::Float, depth.data() },
+      { "primitiveId", ChannelType::Uint, primitiveId.data() }
+    });
+  }
+
+  writeImageEXR(filename, diag.x, diag.y, std::move(channels));
+}
+
+}
@@ -1,40 +1,362 @@
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <nanopt/core/bsdf.h>
+#include <nanopt/core/stats.h>
+#include <nanopt/core/checkpoint.h>
 #include <nanopt/core/integrator.h>
 
 namespace nanopt {
 
-void Integrator::render(const Scene& scene) {
-  constexpr auto TileSize = 16;
-  auto& pixelBounds = camera.film.pixelBounds;
+using Clock = std::chrono::steady_clock;
+
+static float secondsSince(const Clock::time_point& start) {
+  return std::chrono::duration<float>(Clock::now() - start).count();
+}
+
+namespace {
+
+std::uint32_t mortonIndex(std::uint32_t x, std::uint32_t y) {
+  auto spread = [](std::uint32_t v) {
+    v &= 0xffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+  };
+  return spread(x) | (spread(y) << 1);
+}
+
+// Distance along the Hilbert curve filling an n by n grid, n a power of two.
+std::uint32_t hilbertIndex(std::uint32_t n, std::uint32_t x, std::uint32_t y) {
+  std::uint32_t d = 0;
+  for (auto s = n / 2; s > 0; s /= 2) {
+    std::uint32_t rx = (x & s) > 0;
+    std::uint32_t ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+// Splits the film into tiles in the order they should be rendered.
+std::vector<Bounds2i> makeTiles(const Bounds2i& pixelBounds, const RenderOptions& options) {
+  auto tileSize = std::max(1, options.tileSize);
   auto diag = pixelBounds.diag();
   Vector2i nTiles(
-    (diag.x + TileSize - 1) / TileSize,
-    (diag.y + TileSize - 1) / TileSize);
+    (diag.x + tileSize - 1) / tileSize,
+    (diag.y + tileSize - 1) / tileSize);
 
-  parallelFor2D([&](const Vector2i& tile) {
-    auto x0 = pixelBounds.pMin.x + TileSize * tile.x;
-    auto x1 = std::min(pixelBounds.pMax.x, x0 + TileSize);
-    auto y0 = pixelBounds.pMin.y + TileSize * tile.y;
-    auto y1 = std::min(pixelBounds.pMax.y, y0 + TileSize);
-    Bounds2i tileBounds(Vector2i(x0, y0), Vector2i(x1, y1));
+  std::vector<Vector2i> order;
+  for (auto y = 0; y < nTiles.y; ++y)
+    for (auto x = 0; x < nTiles.x; ++x)
+      order.emplace_back(x, y);
 
-    auto seed = tile.y * nTiles.x + tile.x;
-    auto tileSampler = sampler.clone(seed);
+  if (options.tileOrder != TileOrder::RowMajor) {
+    std::uint32_t n = 1;
+    while (n < (std::uint32_t)std::max(nTiles.x, nTiles.y)) n *= 2;
+    auto key = [&](const Vector2i& t) {
+      return options.tileOrder == TileOrder::Morton
+        ? mortonIndex(t.x, t.y)
+        : hilbertIndex(n, t.x, t.y);
+    };
+    std::sort(order.begin(), order.end(), [&](const Vector2i& a, const Vector2i& b) {
+      return key(a) < key(b);
+    });
+  }
 
-    for (auto p : tileBounds) {
-      Spectrum l(0);
-      tileSampler->startPixel();
+  // The last eighth of the tiles is split, which bounds the time threads
+  // wait on the final tile by the cost of a small one. The split does not
+  // depend on the thread count, which would make images depend on it too.
+  auto minTileSize = options.minTileSize;
+  auto nSplit = minTileSize > 0 && minTileSize < tileSize
+    ? std::max(1, (int)order.size() / 8)
+    : 0;
 
-      do {
-        auto cameraSample = sampler.getCameraSample(p);
-        auto ray = camera.generateRay(cameraSample);
-        l += li(ray, scene);
-      } while (tileSampler->startNextSample());
+  std::vector<Bounds2i> tiles;
+  for (auto i = 0; i < (int)order.size(); ++i) {
+    auto x0 = pixelBounds.pMin.x + order[i].x * tileSize;
+    auto y0 = pixelBounds.pMin.y + order[i].y * tileSize;
+    Bounds2i tile(
+      Vector2i(x0, y0),
+      Vector2i(std::min(pixelBounds.pMax.x, x0 + tileSize), std::min(pixelBounds.pMax.y, y0 + tileSize)));
+
+    if (i < (int)order.size() - nSplit) {
+      tiles.push_back(tile);
+      continue;
+    }
+    for (auto y = tile.pMin.y; y < tile.pMax.y; y += minTileSize)
+      for (auto x = tile.pMin.x; x < tile.pMax.x; x += minTileSize)
+        tiles.emplace_back(
+          Vector2i(x, y),
+          Vector2i(std::min(tile.pMax.x, x + minTileSize), std::min(tile.pMax.y, y + minTileSize)));
+  }
+  return tiles;
+}
+
+void writeTileLog(const std::string& filename, const std::vector<TileRecord>& records) {
+  std::ofstream file(filename);
+  if (!file)
+    throw std::runtime_error("Unable to write tile log: " + filename);
+  file << "pass,x0,y0,x1,y1,thread,start,end\n";
+  for (auto& r : records) {
+    file << r.pass << ','
+      << r.bounds.pMin.x << ',' << r.bounds.pMin.y << ','
+      << r.bounds.pMax.x << ',' << r.bounds.pMax.y << ','
+      << r.thread << ',' << r.start << ',' << r.end << '\n';
+  }
+}
+
+// Writes snapshots on a thread of its own rather than the pool, so a slow
+// disk never holds up a pass. If the writer falls behind only the newest
+// pending image is kept.
+class SnapshotWriter {
+public:
+  SnapshotWriter(const std::string& filename, const Vector2i& size)
+    : filename(filename), size(size), thread([this] { run(); })
+  { }
+
+  ~SnapshotWriter() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      done = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+
+  void submit(std::unique_ptr<Spectrum[]> image) {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      pending = std::move(image);
+    }
+    cv.notify_one();
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock(m);
+    while (true) {
+      cv.wait(lock, [this] { return pending || done; });
+      if (!pending) return;
+      auto image = std::move(pending);
+      lock.unlock();
+      try {
+        writeImage(filename, size.x, size.y, image.get());
+      } catch (const std::exception& e) {
+        std::cerr << "Failed to write snapshot: " << e.what() << std::endl;
+      }
+      lock.lock();
+    }
+  }
+
+private:
+  std::string filename;
+  Vector2i size;
+  std::mutex m;
+  std::condition_variable cv;
+  std::unique_ptr<Spectrum[]> pending;
+  bool done = false;
+  std::thread thread;
+};
+
+}
+
+void Integrator::render(const Scene& scene) {
+  auto& film = camera.film;
+  auto spp = (int)sampler.samplesPerPixel;
+  auto adaptive = options.adaptiveThreshold > 0;
+  auto samplesPerPass = options.samplesPerPass > 0
+    ? std::min(options.samplesPerPass, spp)
+    : adaptive ? std::max(1, spp / 16) : spp;
+  auto nPasses = (spp + samplesPerPass - 1) / samplesPerPass;
+
+  auto nPixels = (std::int64_t)renderBounds().area();
+  auto budget = nPixels * spp;
+  auto maxSamples = options.adaptiveMaxSamples > 0 ? options.adaptiveMaxSamples : 8 * spp;
+  auto nActive = nPixels;
+  std::int64_t samplesTaken = 0;
+
+  // Samples per active pixel for the given pass, zero once done. Adaptive
+  // renders give every pixel the minimum first and then keep refining the
+  // noisy ones until the budget is spent.
+  auto passSamples = [&](int pass) -> int {
+    if (!adaptive)
+      return pass < nPasses ? std::min(samplesPerPass, spp - pass * samplesPerPass) : 0;
+    if (pass == 0)
+      return std::max(1, std::min(options.adaptiveMinSamples, spp));
+    nActive = updateActivePixels(maxSamples);
+    if (nActive == 0 || samplesTaken >= budget) return 0;
+    auto remaining = (budget - samplesTaken + nActive - 1) / nActive;
+    return (int)std::min<std::int64_t>(samplesPerPass, remaining);
+  };
+
+  clearStats();
+  preprocess(scene);
+  film.clear();
+  activePixels.clear();
+  tileLog.clear();
 
-      auto offsetX = p.x - pixelBounds.pMin.x;
-      auto offsetY = p.y - pixelBounds.pMin.y;
-      camera.film.pixels[offsetY * diag.x + offsetX] = l / tileSampler->samplesPerPixel;
+  RenderCheckpoint checkpoint;
+  auto checkpointing = !options.checkpointFilename.empty();
+  if (checkpointing && readCheckpoint(options.checkpointFilename, film, spp, samplesPerPass, checkpoint)) {
+    samplesTaken = checkpoint.samplesTaken;
+    std::cout << "Resuming from pass " << checkpoint.pass << std::endl;
+  }
+  if (tracesLightPaths)
+    film.splatScale = film.lightPathSplatScale();
+
+  std::vector<std::unique_ptr<MemoryArena>> arenas(parallelThreadCount());
+  for (auto& arena : arenas)
+    arena.reset(new MemoryArena());
+
+  std::unique_ptr<SnapshotWriter> snapshotWriter;
+  if (!options.snapshotFilename.empty())
+    snapshotWriter.reset(new SnapshotWriter(options.snapshotFilename, film.pixelBounds.diag()));
+
+  auto start = Clock::now();
+  auto lastSnapshot = start;
+  auto lastCheckpoint = start;
+  auto passTime = 0.0f;
+  auto finished = false;
+
+  auto pass = checkpoint.pass;
+  for (;; ++pass) {
+    auto nSamples = passSamples(pass);
+    if (nSamples == 0) {
+      finished = true;
+      break;
     }
-  }, nTiles);
+    if (options.cancellation && options.cancellation->isCancelled()) break;
+    if (pass > checkpoint.pass && secondsSince(start) + passTime > options.timeLimit) break;
+
+    if (checkpointing && secondsSince(lastCheckpoint) >= options.checkpointInterval) {
+      writeCheckpoint(options.checkpointFilename, film, spp, samplesPerPass, { pass, samplesTaken });
+      lastCheckpoint = Clock::now();
+    }
+
+    if (snapshotWriter && pass > 0 && secondsSince(lastSnapshot) >= options.snapshotInterval) {
+      std::unique_ptr<Spectrum[]> image(new Spectrum[film.pixelBounds.area()]);
+      film.resolve(image.get());
+      snapshotWriter->submit(std::move(image));
+      lastSnapshot = Clock::now();
+    }
+
+    auto passStart = Clock::now();
+    renderPass(scene, pass, nSamples, arenas);
+    passTime = secondsSince(passStart);
+    samplesTaken += nActive * nSamples;
+    if (tracesLightPaths)
+      film.splatScale = film.lightPathSplatScale();
+  }
+
+  if (checkpointing) {
+    if (finished)
+      std::remove(options.checkpointFilename.c_str());
+    else
+      writeCheckpoint(options.checkpointFilename, film, spp, samplesPerPass, { pass, samplesTaken });
+  }
+
+  // Waits for a snapshot still being written, the caller may write the
+  // final image to the same file.
+  snapshotWriter.reset();
+  film.resolve();
+  if (!options.tileLogFilename.empty())
+    writeTileLog(options.tileLogFilename, tileLog);
+  if (options.printStats)
+    printStats(std::cout);
+}
+
+Bounds2i Integrator::renderBounds() const {
+  auto& pixelBounds = camera.film.pixelBounds;
+  if (options.region.isDegenerate()) return pixelBounds;
+  return Bounds2i(
+    Vector2i(std::max(pixelBounds.pMin.x, options.region.pMin.x), std::max(pixelBounds.pMin.y, options.region.pMin.y)),
+    Vector2i(std::min(pixelBounds.pMax.x, options.region.pMax.x), std::min(pixelBounds.pMax.y, options.region.pMax.y)));
+}
+
+void Integrator::preprocess(const Scene& scene) {
+  lightSampler = createLightSampler(options.lightSampling, scene.lights);
+}
+
+void Integrator::recordAOV(AOVSample& aov, const Ray& ray, const Interaction& isect) {
+  aov.albedo = isect.bsdf ? isect.bsdf->albedo() : Spectrum(0);
+  aov.normal = isect.ns;
+  aov.depth = distance(ray.o, isect.p);
+  aov.primitiveId = isect.primitiveId;
+}
+
+std::int64_t Integrator::updateActivePixels(int maxSamples) {
+  auto& film = camera.film;
+  activePixels.assign(film.pixelBounds.area(), false);
+
+  std::int64_t nActive = 0;
+  for (auto p : renderBounds()) {
+    auto i = film.pixelIndex(p);
+    activePixels[i] = film.accum[i].nSamples < maxSamples &&
+      film.relativeError(i) >= options.adaptiveThreshold;
+    nActive += activePixels[i];
+  }
+  return nActive;
+}
+
+void Integrator::renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas) {
+
+  auto& film = camera.film;
+  auto tiles = makeTiles(renderBounds(), options);
+  auto logTiles = !options.tileLogFilename.empty();
+  std::vector<TileRecord> records(logTiles ? tiles.size() : 0);
+  OrderedTileMerger merger(film, tiles.size());
+  auto passStart = Clock::now();
+
+  parallelFor([&](std::int64_t index) {
+    auto& tileBounds = tiles[index];
+    auto tileStart = secondsSince(passStart);
+
+    // Seeded by the tile position rather than its index, so the order
+    // tiles are handed out in does not change the image.
+    auto tileSampler = sampler.clone(streamSeed({ pass, film.pixelIndex(tileBounds.pMin) }));
+    RenderContext ctx(*tileSampler, *arenas[parallelThreadIndex()], threadStats());
+    auto filmTile = film.getFilmTile(tileBounds);
+
+    for (auto p : tileBounds) {
+      if (!isPixelActive(p)) continue;
+      ctx.sampler.startPixel();
+      for (auto i = 0; i < nSamples; ++i) {
+        auto cameraSample = ctx.sampler.getCameraSample(p);
+        auto ray = camera.generateRay(cameraSample);
+        NANOPT_STAT_INC_TO(ctx.stats, CameraRays);
+        AOVSample aov;
+        ctx.aov = film.aovs ? &aov : nullptr;
+        filmTile.addSample(cameraSample.pFilm, li(ray, scene, ctx));
+        if (ctx.aov) film.addAOVSample(cameraSample.pFilm, aov);
+        ctx.arena.reset();
+        ctx.sampler.startNextSample();
+      }
+    }
+
+    merger.merge(index, std::move(filmTile));
+
+    if (logTiles)
+      records[index] = { pass, tileBounds, parallelThreadIndex(), tileStart, secondsSince(passStart) };
+  }, tiles.size());
+
+  tileLog.insert(tileLog.end(), records.begin(), records.end());
 }
 
 }
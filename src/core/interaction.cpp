@@ -4,19 +4,15 @@
 
 namespace nanopt {
 
-Interaction::~Interaction() noexcept {
-  if (bsdf) delete bsdf;
-}
-
 Spectrum Interaction::le(const Vector3f& w) const {
   if (triangle->light)
     return triangle->light->le(*this, w);
   return Spectrum(0);
 }
 
-void Interaction::computeScatteringFunctions() {
+void Interaction::computeScatteringFunctions(MemoryArena& arena) {
   if (triangle->material) {
-    triangle->material->computeScatteringFunctions(*this);
+    triangle->material->computeScatteringFunctions(*this, arena);
   }
 }
 
@@ -0,0 +1,102 @@
+#include <cmath>
+#include <mutex>
+#include <nanopt/core/irradiancecache.h>
+
+namespace nanopt {
+
+namespace {
+
+constexpr auto MaxOctreeDepth = 16;
+
+Bounds3f childBounds(const Bounds3f& b, int child) {
+  auto mid = b.centroid();
+  return Bounds3f(
+    Vector3f(child & 1 ? mid.x : b.pMin.x, child & 2 ? mid.y : b.pMin.y, child & 4 ? mid.z : b.pMin.z),
+    Vector3f(child & 1 ? b.pMax.x : mid.x, child & 2 ? b.pMax.y : mid.y, child & 4 ? b.pMax.z : mid.z));
+}
+
+bool overlaps(const Bounds3f& a, const Bounds3f& b) {
+  return a.pMax.x >= b.pMin.x && a.pMin.x <= b.pMax.x &&
+         a.pMax.y >= b.pMin.y && a.pMin.y <= b.pMax.y &&
+         a.pMax.z >= b.pMin.z && a.pMin.z <= b.pMax.z;
+}
+
+}
+
+IrradianceCache::IrradianceCache(const Bounds3f& bounds)
+  : bounds(bounds)
+{ }
+
+IrradianceCache::~IrradianceCache() = default;
+
+void IrradianceCache::add(const IrradianceRecord& record, float maxError) {
+  auto r = Vector3f(record.radius * maxError);
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  add(root, bounds, 0, record, Bounds3f(record.p - r, record.p + r));
+  ++nRecords;
+}
+
+void IrradianceCache::add(
+    Node& node, const Bounds3f& nodeBounds, int depth,
+    const IrradianceRecord& record, const Bounds3f& recordBounds) {
+
+  // Records live in the first nodes no larger than the region they are
+  // valid in, so a lookup only visits the nodes along one path.
+  if (depth == MaxOctreeDepth || nodeBounds.diag().lengthSquared() <= recordBounds.diag().lengthSquared()) {
+    node.records.push_back(record);
+    return;
+  }
+  for (auto i = 0; i < 8; ++i) {
+    auto b = childBounds(nodeBounds, i);
+    if (!overlaps(b, recordBounds)) continue;
+    auto& child = node.children[i];
+    if (!child) child.reset(new Node());
+    add(*child, b, depth + 1, record, recordBounds);
+  }
+}
+
+bool IrradianceCache::interpolate(const Vector3f& p, const Vector3f& n, float maxError, Spectrum& e) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto sum = Spectrum(0);
+  auto weightSum = 0.0f;
+  auto node = &root;
+  auto b = bounds;
+  while (node) {
+    for (auto& r : node->records) {
+      // Ward's weight, the inverse of the error the record would make at
+      // p, which grows with distance and with the normals' divergence.
+      auto d = p - r.p;
+      auto distance = d.length();
+      auto cosNormals = dot(n, r.n);
+      if (cosNormals <= 0) continue;
+      auto error = distance / r.radius + std::sqrt(std::max(0.0f, 1 - cosNormals));
+      if (error >= maxError) continue;
+      // Points in front of the record see what it could not.
+      if (dot(d, n + r.n) / 2 < -0.05f * r.radius) continue;
+
+      auto w = 1 / std::max(error, 1e-6f);
+      auto rotation = cross(r.n, n);
+      Spectrum ei;
+      for (auto c = 0; c < 3; ++c)
+        ei[c] = std::max(0.0f, r.e[c] + dot(d, r.translationGradient[c]) + dot(rotation, r.rotationGradient[c]));
+      sum += ei * w;
+      weightSum += w;
+    }
+
+    auto mid = b.centroid();
+    auto child = (p.x > mid.x ? 1 : 0) + (p.y > mid.y ? 2 : 0) + (p.z > mid.z ? 4 : 0);
+    b = childBounds(b, child);
+    node = node->children[child].get();
+  }
+
+  if (weightSum == 0) return false;
+  e = sum / weightSum;
+  return true;
+}
+
+int IrradianceCache::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return nRecords;
+}
+
+}
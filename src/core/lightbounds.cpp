@@ -0,0 +1,116 @@
+#include <cmath>
+#include <algorithm>
+#include <nanopt/math/math.h>
+#include <nanopt/core/lightbounds.h>
+
+namespace nanopt {
+
+namespace {
+
+float safeSqrt(float x) {
+  return std::sqrt(std::max(0.0f, x));
+}
+
+float safeAcos(float x) {
+  return std::acos(clamp(x, -1, 1));
+}
+
+// Cosine and sine of the angle a - b, clamped to zero when b exceeds a.
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+  return cosA > cosB ? 1 : cosA * cosB + sinA * sinB;
+}
+
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+  return cosA > cosB ? 0 : sinA * cosB - cosA * sinB;
+}
+
+// Cosine of the half angle of the cone of directions from p that hits
+// bounds, -1 when p lies inside.
+float cosSubtended(const Bounds3f& bounds, const Vector3f& p) {
+  auto inside = p.x >= bounds.pMin.x && p.x <= bounds.pMax.x &&
+                p.y >= bounds.pMin.y && p.y <= bounds.pMax.y &&
+                p.z >= bounds.pMin.z && p.z <= bounds.pMax.z;
+  if (inside) return -1;
+  auto center = bounds.centroid();
+  auto radius2 = bounds.diag().lengthSquared() / 4;
+  auto distance2 = (p - center).lengthSquared();
+  if (distance2 < radius2) return -1;
+  return safeSqrt(1 - radius2 / distance2);
+}
+
+// Rotates v by angle theta around the unit axis k.
+Vector3f rotate(const Vector3f& v, const Vector3f& k, float theta) {
+  auto c = std::cos(theta);
+  auto s = std::sin(theta);
+  return v * c + cross(k, v) * s + k * (dot(k, v) * (1 - c));
+}
+
+}
+
+float LightBounds::importance(const Vector3f& p, const Vector3f& n) const {
+  auto pc = bounds.centroid();
+  auto d2 = std::max((p - pc).lengthSquared(), bounds.diag().length() / 2);
+  auto wi = normalize(p - pc);
+
+  auto cosThetaW = dot(w, wi);
+  if (twoSided) cosThetaW = std::abs(cosThetaW);
+  auto sinThetaW = safeSqrt(1 - cosThetaW * cosThetaW);
+
+  auto cosThetaB = cosSubtended(bounds, p);
+  auto sinThetaB = safeSqrt(1 - cosThetaB * cosThetaB);
+
+  // Smallest angle between the emission cone, grown by the angle the
+  // bounds subtend, and the direction towards p.
+  auto sinThetaO = safeSqrt(1 - cosThetaO * cosThetaO);
+  auto cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+  auto sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+  auto cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+  if (cosThetaP <= cosThetaE) return 0;
+
+  auto importance = phi * cosThetaP / d2;
+  if (n.x != 0 || n.y != 0 || n.z != 0) {
+    auto cosThetaI = absdot(wi, n);
+    auto sinThetaI = safeSqrt(1 - cosThetaI * cosThetaI);
+    importance *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+  }
+  return std::max(importance, 0.0f);
+}
+
+LightBounds merge(const LightBounds& a, const LightBounds& b) {
+  if (a.phi == 0) return b;
+  if (b.phi == 0) return a;
+
+  LightBounds result;
+  result.bounds = merge(a.bounds, b.bounds);
+  result.phi = a.phi + b.phi;
+  result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+  result.twoSided = a.twoSided || b.twoSided;
+
+  // Smallest cone holding both emission cones.
+  auto thetaA = safeAcos(a.cosThetaO);
+  auto thetaB = safeAcos(b.cosThetaO);
+  auto thetaD = safeAcos(dot(a.w, b.w));
+  if (std::min(thetaD + thetaB, Pi) <= thetaA) {
+    result.w = a.w;
+    result.cosThetaO = a.cosThetaO;
+    return result;
+  }
+  if (std::min(thetaD + thetaA, Pi) <= thetaB) {
+    result.w = b.w;
+    result.cosThetaO = b.cosThetaO;
+    return result;
+  }
+
+  auto thetaO = (thetaA + thetaD + thetaB) / 2;
+  auto axis = cross(a.w, b.w);
+  if (thetaO >= Pi || axis.lengthSquared() == 0) {
+    result.w = a.w;
+    result.cosThetaO = -1;
+    return result;
+  }
+  result.w = normalize(rotate(a.w, normalize(axis), thetaO - thetaA));
+  result.cosThetaO = std::cos(thetaO);
+  return result;
+}
+
+}
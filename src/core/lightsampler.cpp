@@ -0,0 +1,20 @@
+#include <nanopt/core/lightsampler.h>
+#include <nanopt/lightsamplers/bvh.h>
+#include <nanopt/lightsamplers/power.h>
+#include <nanopt/lightsamplers/uniform.h>
+
+namespace nanopt {
+
+std::unique_ptr<LightSampler> createLightSampler(LightSampling type, const std::vector<Light*>& lights) {
+  switch (type) {
+    case LightSampling::Uniform:
+      return std::make_unique<UniformLightSampler>(lights);
+    case LightSampling::Power:
+      return std::make_unique<PowerLightSampler>(lights);
+    case LightSampling::BVH:
+      break;
+  }
+  return std::make_unique<BVHLightSampler>(lights);
+}
+
+}
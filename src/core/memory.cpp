@@ -0,0 +1,33 @@
+#include <algorithm>
+#include <nanopt/core/memory.h>
+
+namespace nanopt {
+
+void MemoryArena::nextBlock(std::size_t nBytes) {
+  auto it = std::find_if(availableBlocks.begin(), availableBlocks.end(), [=](auto& block) {
+    return block.first >= nBytes;
+  });
+
+  if (it != availableBlocks.end()) {
+    usedBlocks.push_back(std::move(*it));
+    availableBlocks.erase(it);
+  } else {
+    auto size = std::max(nBytes, blockSize);
+    usedBlocks.emplace_back(size, std::unique_ptr<std::uint8_t[]>(new std::uint8_t[size]));
+  }
+
+  currentOffset = 0;
+  currentSize = usedBlocks.back().first;
+  currentBlock = usedBlocks.back().second.get();
+}
+
+void MemoryArena::reset() {
+  for (auto& block : usedBlocks)
+    availableBlocks.push_back(std::move(block));
+  usedBlocks.clear();
+  currentOffset = 0;
+  currentSize = 0;
+  currentBlock = nullptr;
+}
+
+}
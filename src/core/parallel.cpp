@@ -1,8 +1,10 @@
 #include <cstdint>
 #include <vector>
 #include <algorithm>
+#include <deque>
 #include <thread>
 #include <mutex>
+#include <exception>
 #include <condition_variable>
 #include <nanopt/core/parallel.h>
 
@@ -12,9 +14,11 @@ class ParallelForLoop;
 
 static auto shutdownThreads = false;
 static ParallelForLoop* workList = nullptr;
+static std::deque<std::shared_ptr<AsyncTask>> readyTasks;
 static std::mutex m;
 static std::condition_variable cv;
 static std::vector<std::thread> threads;
+static thread_local int threadIndex = 0;
 
 
 class ParallelForLoop {
@@ -42,11 +46,48 @@ public:
   ParallelForLoop* next = nullptr;
 };
 
-void workerThreadFunc() {
+class AsyncTask {
+public:
+  explicit AsyncTask(std::function<void()>&& func) noexcept : func(std::move(func))
+  { }
+
+public:
+  std::function<void()> func;
+  std::exception_ptr exception;
+  int pendingDependencies = 0;
+  bool finished = false;
+  std::vector<std::shared_ptr<AsyncTask>> successors;
+};
+
+static void runReadyTask(std::unique_lock<std::mutex>& lock) {
+  auto task = std::move(readyTasks.front());
+  readyTasks.pop_front();
+
+  lock.unlock();
+  try {
+    task->func();
+  } catch (...) {
+    task->exception = std::current_exception();
+  }
+  task->func = nullptr;
+  lock.lock();
+
+  task->finished = true;
+  for (auto& successor : task->successors)
+    if (--successor->pendingDependencies == 0)
+      readyTasks.push_back(std::move(successor));
+  task->successors.clear();
+  cv.notify_all();
+}
+
+void workerThreadFunc(int index) {
+  threadIndex = index;
   std::unique_lock<std::mutex> lock(m);
   while (!shutdownThreads) {
-    if (!workList) cv.wait(lock);
-    else {
+    if (!workList) {
+      if (readyTasks.empty()) cv.wait(lock);
+      else runReadyTask(lock);
+    } else {
       auto& loop = *workList;
       auto beg = loop.nextIndex;
       auto end = std::min(loop.nextIndex + loop.chunkSize, loop.count);
@@ -68,15 +109,26 @@ void workerThreadFunc() {
   }
 }
 
-void parallelInit() {
-  auto maxThreads = (int)std::max(std::thread::hardware_concurrency(), 1u) - 1;
+void parallelInit(int nThreads) {
+  if (nThreads <= 0) nThreads = (int)std::max(std::thread::hardware_concurrency(), 1u);
+  auto maxThreads = nThreads - 1;
   for (auto i = 0; i < maxThreads; ++i)
-    threads.emplace_back(workerThreadFunc);
+    threads.emplace_back(workerThreadFunc, i + 1);
+}
+
+int parallelThreadIndex() {
+  return threadIndex;
+}
+
+int parallelThreadCount() {
+  return (int)threads.size() + 1;
 }
 
 void parallelCleanup() {
   {
-    std::lock_guard<std::mutex> gurad(m);
+    std::unique_lock<std::mutex> lock(m);
+    while (!readyTasks.empty())
+      runReadyTask(lock);
     shutdownThreads = true;
   }
   cv.notify_all();
@@ -148,4 +200,35 @@ void parallelFor2D(std::function<void(const Vector2i&)> func, const Vector2i& co
   }
 }
 
+std::shared_ptr<AsyncTask> parallelSubmit(
+  std::function<void()> func,
+  const std::vector<std::shared_ptr<AsyncTask>>& dependencies) {
+
+  auto task = std::make_shared<AsyncTask>(std::move(func));
+  std::unique_lock<std::mutex> lock(m);
+  for (auto& dependency : dependencies) {
+    if (dependency->finished) continue;
+    ++task->pendingDependencies;
+    dependency->successors.push_back(task);
+  }
+
+  if (task->pendingDependencies == 0) {
+    readyTasks.push_back(task);
+    if (threads.empty()) runReadyTask(lock);
+    else cv.notify_all();
+  }
+
+  return task;
+}
+
+void parallelWait(const std::shared_ptr<AsyncTask>& task) {
+  std::unique_lock<std::mutex> lock(m);
+  while (!task->finished) {
+    if (readyTasks.empty()) cv.wait(lock);
+    else runReadyTask(lock);
+  }
+  if (task->exception)
+    std::rethrow_exception(task->exception);
+}
+
 }
@@ -0,0 +1,216 @@
+#include <cmath>
+#include <algorithm>
+#include <nanopt/math/math.h>
+#include <nanopt/core/frame.h>
+#include <nanopt/core/sdtree.h>
+
+namespace nanopt {
+
+namespace {
+
+constexpr auto MaxDTreeDepth = 20;
+
+void atomicAdd(std::atomic<float>& a, float v) {
+  auto old = a.load(std::memory_order_relaxed);
+  while (!a.compare_exchange_weak(old, old + v, std::memory_order_relaxed))
+    ;
+}
+
+Vector2f toSquare(const Vector3f& w) {
+  auto phi = std::atan2(w.y, w.x);
+  if (phi < 0) phi += 2 * Pi;
+  return Vector2f(
+    clamp((w.z + 1) / 2, 0, OneMinusEpsilon),
+    clamp(phi * Inv2Pi, 0, OneMinusEpsilon));
+}
+
+Vector3f fromSquare(const Vector2f& p) {
+  auto cosTheta = 2 * p.x - 1;
+  auto sinTheta = std::sqrt(std::max(0.0f, 1 - cosTheta * cosTheta));
+  return sphericalDirection(sinTheta, cosTheta, 2 * Pi * p.y);
+}
+
+// Picks the half holding u of the way through energies a and b and
+// rescales u to the chosen half.
+int sampleHalf(float& u, float a, float b) {
+  auto total = a + b;
+  if (u * total < a) {
+    u = std::min(u * total / a, OneMinusEpsilon);
+    return 0;
+  }
+  u = b > 0 ? std::min((u * total - a) / b, OneMinusEpsilon) : 0;
+  return 1;
+}
+
+}
+
+float DTree::total() const {
+  return nodes[0].total();
+}
+
+void DTree::record(const Vector3f& w, float energy) {
+  auto p = toSquare(w);
+  auto index = 0;
+  while (true) {
+    auto x = p.x >= 0.5f ? 1 : 0;
+    auto y = p.y >= 0.5f ? 1 : 0;
+    auto q = x + 2 * y;
+    auto& node = nodes[index];
+    atomicAdd(node.sum[q], energy);
+    if (!node.child[q]) return;
+    p = Vector2f(p.x * 2 - x, p.y * 2 - y);
+    index = node.child[q];
+  }
+}
+
+Vector3f DTree::sample(const Vector2f& sample) const {
+  auto u = sample;
+  auto origin = Vector2f(0, 0);
+  auto size = 1.0f;
+  auto index = 0;
+  while (true) {
+    auto& node = nodes[index];
+    float s[4] = { node.sum[0], node.sum[1], node.sum[2], node.sum[3] };
+    auto x = sampleHalf(u.x, s[0] + s[2], s[1] + s[3]);
+    auto y = sampleHalf(u.y, s[x], s[x + 2]);
+    size /= 2;
+    origin = origin + Vector2f((float)x, (float)y) * size;
+    auto child = node.child[x + 2 * y];
+    if (!child) return fromSquare(origin + u * size);
+    index = child;
+  }
+}
+
+float DTree::pdf(const Vector3f& w) const {
+  auto p = toSquare(w);
+  auto density = Inv4Pi;
+  auto index = 0;
+  while (true) {
+    auto& node = nodes[index];
+    auto total = node.total();
+    if (total <= 0) return 0;
+    auto x = p.x >= 0.5f ? 1 : 0;
+    auto y = p.y >= 0.5f ? 1 : 0;
+    auto q = x + 2 * y;
+    density *= 4 * node.sum[q] / total;
+    if (!node.child[q]) return density;
+    p = Vector2f(p.x * 2 - x, p.y * 2 - y);
+    index = node.child[q];
+  }
+}
+
+DTree DTree::refined(float threshold) const {
+  DTree result;
+  auto t = total();
+  if (t <= 0) {
+    result.nodes = nodes;
+    for (auto& node : result.nodes)
+      for (auto& sum : node.sum)
+        sum = 0;
+    return result;
+  }
+
+  float fraction[4];
+  for (auto i = 0; i < 4; ++i)
+    fraction[i] = nodes[0].sum[i] / t;
+  result.refine(*this, 0, fraction, 0, 1, threshold);
+  return result;
+}
+
+void DTree::refine(const DTree& from, int fromIndex, const float fraction[4], int index, int depth, float threshold) {
+  for (auto q = 0; q < 4; ++q) {
+    if (fraction[q] <= threshold || depth >= MaxDTreeDepth) continue;
+
+    // Quadrants the old tree did not split are assumed to be uniform.
+    auto fromChild = fromIndex >= 0 ? from.nodes[fromIndex].child[q] : 0;
+    auto childTotal = fromChild ? from.nodes[fromChild].total() : 0.0f;
+    float childFraction[4];
+    for (auto i = 0; i < 4; ++i) {
+      childFraction[i] = childTotal > 0
+        ? fraction[q] * from.nodes[fromChild].sum[i] / childTotal
+        : fraction[q] / 4;
+    }
+
+    auto child = (int)nodes.size();
+    nodes.emplace_back();
+    nodes[index].child[q] = child;
+    refine(from, fromChild ? fromChild : -1, childFraction, child, depth + 1, threshold);
+  }
+}
+
+SDTree::SDTree(const Bounds3f& sceneBounds) {
+  // A cube, so that splitting the axes in turn keeps cells cubes too.
+  auto d = sceneBounds.diag();
+  auto size = std::max(d.x, std::max(d.y, d.z));
+  bounds = Bounds3f(sceneBounds.pMin, sceneBounds.pMin + Vector3f(size, size, size));
+  nodes.push_back({ 0, 0, 0 });
+  leaves.emplace_back(new Leaf());
+}
+
+int SDTree::leafIndex(const Vector3f& p) const {
+  auto pMin = bounds.pMin;
+  auto pMax = bounds.pMax;
+  auto index = 0;
+  while (nodes[index].child) {
+    auto axis = nodes[index].axis;
+    auto mid = (pMin[axis] + pMax[axis]) / 2;
+    if (p[axis] < mid) {
+      pMax[axis] = mid;
+      index = nodes[index].child;
+    } else {
+      pMin[axis] = mid;
+      index = nodes[index].child + 1;
+    }
+  }
+  return nodes[index].leaf;
+}
+
+void SDTree::record(const Vector3f& p, const Vector3f& w, float energy) {
+  auto& leaf = *leaves[leafIndex(p)];
+  leaf.nSamples.fetch_add(1, std::memory_order_relaxed);
+  leaf.building.record(w, energy);
+}
+
+void SDTree::refine(int spatialThreshold, float directionalThreshold) {
+  for (auto& leaf : leaves) {
+    leaf->sampling = leaf->building;
+    leaf->building = leaf->sampling.refined(directionalThreshold);
+  }
+
+  auto nNodes = (int)nodes.size();
+  for (auto i = 0; i < nNodes; ++i) {
+    if (!nodes[i].child && leaves[nodes[i].leaf]->nSamples > spatialThreshold)
+      split(i, spatialThreshold);
+  }
+
+  for (auto& leaf : leaves)
+    leaf->nSamples = 0;
+}
+
+void SDTree::split(int index, int threshold) {
+  auto leafIndex = nodes[index].leaf;
+  auto& leaf = *leaves[leafIndex];
+  auto nSamples = leaf.nSamples / 2;
+  leaf.nSamples = nSamples;
+
+  // Both halves start out with what the whole leaf learned.
+  auto other = new Leaf();
+  other->sampling = leaf.sampling;
+  other->building = leaf.building;
+  other->nSamples = nSamples;
+  auto otherIndex = (int)leaves.size();
+  leaves.emplace_back(other);
+
+  auto axis = (nodes[index].axis + 1) % 3;
+  auto child = (int)nodes.size();
+  nodes.push_back({ 0, leafIndex, axis });
+  nodes.push_back({ 0, otherIndex, axis });
+  nodes[index].child = child;
+
+  if (nSamples > threshold) {
+    split(child, threshold);
+    split(child + 1, threshold);
+  }
+}
+
+}
@@ -0,0 +1,98 @@
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <nanopt/core/stats.h>
+
+namespace nanopt {
+
+static std::mutex statsMutex;
+static std::vector<std::unique_ptr<ThreadStats>> allThreadStats;
+
+static const char* counterNames[] = {
+  "Integrator/Camera rays traced",
+  "Accelerator/Intersection rays",
+  "Accelerator/Shadow rays",
+  "Accelerator/BVH nodes visited",
+  "Accelerator/Triangle intersection tests",
+  "Integrator/BSDF samples",
+  "Integrator/Paths terminated by Russian roulette",
+  "Integrator/Irradiance cache records"
+};
+
+static const char* distributionNames[] = {
+  "Integrator/Path length"
+};
+
+static_assert(sizeof(counterNames) / sizeof(counterNames[0]) == (int)StatCounter::Count);
+static_assert(sizeof(distributionNames) / sizeof(distributionNames[0]) == (int)StatDistribution::Count);
+
+ThreadStats* registerThreadStats() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  allThreadStats.push_back(std::make_unique<ThreadStats>());
+  return allThreadStats.back().get();
+}
+
+void clearStats() {
+  std::lock_guard<std::mutex> lock(statsMutex);
+  for (auto& stats : allThreadStats)
+    stats->clear();
+}
+
+ThreadStats mergeStats() {
+  ThreadStats total;
+  std::lock_guard<std::mutex> lock(statsMutex);
+  for (auto& stats : allThreadStats)
+    total.merge(*stats);
+  return total;
+}
+
+void printStats(std::ostream& os) {
+#ifdef NANOPT_ENABLE_STATS
+  auto stats = mergeStats();
+  os << "Statistics:\n";
+  for (auto i = 0; i < (int)StatCounter::Count; ++i)
+    os << "  " << std::left << std::setw(52) << counterNames[i]
+       << std::right << std::setw(16) << stats.counters[i] << "\n";
+  for (auto i = 0; i < (int)StatDistribution::Count; ++i) {
+    auto& d = stats.distributions[i];
+    os << "  " << std::left << std::setw(52) << distributionNames[i] << std::right;
+    if (d.count == 0) {
+      os << std::setw(16) << "-" << "\n";
+      continue;
+    }
+    os << std::setw(16) << std::fixed << std::setprecision(3) << d.average()
+       << " avg [range " << d.min << " - " << d.max << "]\n";
+    os.unsetf(std::ios::floatfield);
+  }
+#endif
+}
+
+void writeStatsJSON(const std::string& filename) {
+  std::ofstream file(filename);
+  if (file.fail())
+    throw std::runtime_error("Unable to write stats file: " + filename);
+
+  auto stats = mergeStats();
+  file << "{\n  \"counters\": {\n";
+  for (auto i = 0; i < (int)StatCounter::Count; ++i) {
+    file << "    \"" << counterNames[i] << "\": " << stats.counters[i];
+    file << (i + 1 < (int)StatCounter::Count ? ",\n" : "\n");
+  }
+  file << "  },\n  \"distributions\": {\n";
+  for (auto i = 0; i < (int)StatDistribution::Count; ++i) {
+    auto& d = stats.distributions[i];
+    file << "    \"" << distributionNames[i] << "\": { "
+         << "\"count\": " << d.count << ", "
+         << "\"sum\": " << d.sum << ", "
+         << "\"min\": " << (d.count ? d.min : 0) << ", "
+         << "\"max\": " << (d.count ? d.max : 0) << ", "
+         << "\"avg\": " << d.average() << " }";
+    file << (i + 1 < (int)StatDistribution::Count ? ",\n" : "\n");
+  }
+  file << "  }\n}\n";
+}
+
+}
@@ -4,7 +4,7 @@
 namespace nanopt {
 
 bool VisibilityTester::unoccluded(const Scene& scene) const {
-  return !scene.intersect(ref->spawnRayTo(target));
+  return !scene.intersect(shadowRay());
 }
 
 }
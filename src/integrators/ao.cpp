@@ -0,0 +1,145 @@
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <nanopt/core/frame.h>
+#include <nanopt/core/memory.h>
+#include <nanopt/core/parallel.h>
+#include <nanopt/core/sampling.h>
+#include <nanopt/integrators/ao.h>
+
+namespace nanopt {
+
+Spectrum AmbientOcclusionIntegrator::li(const Ray& ray, const Scene& scene, RenderContext& ctx) const {
+  Interaction isect;
+  if (!scene.intersect(ray, isect)) return Spectrum(0);
+  // The hemisphere faces the camera, back faces included.
+  auto n = faceForward(isect.n, isect.wo);
+  return Spectrum(visibility(scene, isect.p, n, ctx.sampler.get2D(), ctx.arena));
+}
+
+float AmbientOcclusionIntegrator::visibility(
+    const Scene& scene,
+    const Vector3f& p, const Vector3f& n,
+    const Vector2f& offset, MemoryArena& arena) const {
+
+  auto rays = (Ray*)arena.alloc(sizeof(Ray) * samples, alignof(Ray));
+  auto occluded = (bool*)arena.alloc(sizeof(bool) * samples);
+  Frame frame(n);
+  auto o = p + n * Interaction::RayOriginOffsetEpsilon;
+  for (auto i = 0; i < samples; ++i) {
+    auto u = hammersley(i, samples) + offset;
+    u.x = std::min(u.x < 1 ? u.x : u.x - 1, OneMinusEpsilon);
+    u.y = std::min(u.y < 1 ? u.y : u.y - 1, OneMinusEpsilon);
+    new (&rays[i]) Ray(o, frame.toWorld(consineSampleHemisphere(u)), maxDistance);
+  }
+  scene.occludedStream(rays, samples, occluded);
+
+  auto unoccluded = 0;
+  for (auto i = 0; i < samples; ++i)
+    if (!occluded[i]) ++unoccluded;
+  return (float)unoccluded / samples;
+}
+
+std::vector<float> AmbientOcclusionIntegrator::bakeVertices(const Mesh& mesh, const Scene& scene, int seed) const {
+  std::vector<Vector3f> normals(mesh.nVertices, Vector3f(0, 0, 0));
+  if (mesh.n) {
+    for (auto i = 0; i < mesh.nVertices; ++i)
+      normals[i] = mesh.n[i];
+  } else {
+    // Unnormalized face normals, so larger faces count for more.
+    for (auto i = 0; i < mesh.nTriangles; ++i) {
+      auto indices = mesh.indices.get() + i * 3;
+      auto& a = mesh.p[indices[0]];
+      auto& b = mesh.p[indices[1]];
+      auto& c = mesh.p[indices[2]];
+      auto n = cross(c - a, b - a);
+      for (auto j = 0; j < 3; ++j)
+        normals[indices[j]] = normals[indices[j]] + n;
+    }
+    for (auto& n : normals)
+      if (n.lengthSquared() > 0) n = normalize(n);
+  }
+
+  constexpr auto chunkSize = 256;
+  std::vector<float> ao(mesh.nVertices, 1.0f);
+  auto nChunks = (mesh.nVertices + chunkSize - 1) / chunkSize;
+  parallelFor([&](std::int64_t chunk) {
+    auto sampler = this->sampler.clone(streamSeed({ seed, chunk }));
+    MemoryArena arena;
+    auto end = std::min((int)(chunk + 1) * chunkSize, mesh.nVertices);
+    for (auto i = (int)chunk * chunkSize; i < end; ++i) {
+      auto u = sampler->get2D();
+      if (normals[i].lengthSquared() == 0) continue;
+      ao[i] = visibility(scene, mesh.p[i], normals[i], u, arena);
+      arena.reset();
+    }
+  }, nChunks);
+  return ao;
+}
+
+std::unique_ptr<Spectrum[]> AmbientOcclusionIntegrator::bakeTexture(
+    const Mesh& mesh, const Scene& scene,
+    const Vector2i& resolution, int seed) const {
+
+  if (!mesh.uv)
+    throw std::runtime_error("Baking ambient occlusion to a texture needs uvs");
+
+  // Rasterize the uv layout first, remembering the triangle and
+  // barycentric coordinates of every texel center it covers. Where
+  // triangles overlap in uv space the last one wins.
+  auto nTexels = resolution.x * resolution.y;
+  std::vector<int> texelTriangle(nTexels, -1);
+  std::vector<Vector2f> texelBarycentric(nTexels);
+  for (auto i = 0; i < mesh.nTriangles; ++i) {
+    auto indices = mesh.indices.get() + i * 3;
+    auto a = mesh.uv[indices[0]];
+    auto e1 = mesh.uv[indices[1]] - a;
+    auto e2 = mesh.uv[indices[2]] - a;
+    auto det = e1.x * e2.y - e1.y * e2.x;
+    if (std::abs(det) < 1e-12f) continue;
+
+    auto uMin = std::min({ a.x, a.x + e1.x, a.x + e2.x });
+    auto uMax = std::max({ a.x, a.x + e1.x, a.x + e2.x });
+    auto vMin = std::min({ a.y, a.y + e1.y, a.y + e2.y });
+    auto vMax = std::max({ a.y, a.y + e1.y, a.y + e2.y });
+    auto x0 = std::max(0, (int)std::floor(uMin * resolution.x));
+    auto x1 = std::min(resolution.x - 1, (int)std::ceil(uMax * resolution.x));
+    auto y0 = std::max(0, (int)std::floor((1 - vMax) * resolution.y));
+    auto y1 = std::min(resolution.y - 1, (int)std::ceil((1 - vMin) * resolution.y));
+    for (auto y = y0; y <= y1; ++y) {
+      for (auto x = x0; x <= x1; ++x) {
+        auto d = Vector2f((x + 0.5f) / resolution.x, 1 - (y + 0.5f) / resolution.y) - a;
+        auto b1 = (d.x * e2.y - d.y * e2.x) / det;
+        auto b2 = (e1.x * d.y - e1.y * d.x) / det;
+        if (b1 < 0 || b2 < 0 || b1 + b2 > 1) continue;
+        texelTriangle[y * resolution.x + x] = i;
+        texelBarycentric[y * resolution.x + x] = Vector2f(b1, b2);
+      }
+    }
+  }
+
+  std::unique_ptr<Spectrum[]> image(new Spectrum[nTexels]);
+  parallelFor([&](std::int64_t y) {
+    auto sampler = this->sampler.clone(streamSeed({ seed, y }));
+    MemoryArena arena;
+    for (auto x = 0; x < resolution.x; ++x) {
+      auto texel = y * resolution.x + x;
+      auto u = sampler->get2D();
+      image[texel] = Spectrum(0);
+      if (texelTriangle[texel] < 0) continue;
+
+      auto indices = mesh.indices.get() + texelTriangle[texel] * 3;
+      auto& b = texelBarycentric[texel];
+      auto p = barycentric(mesh.p[indices[0]], mesh.p[indices[1]], mesh.p[indices[2]], b);
+      auto n = mesh.n && mesh.shadingMode == ShadingMode::Smooth ?
+        barycentric(mesh.n[indices[0]], mesh.n[indices[1]], mesh.n[indices[2]], b) :
+        cross(mesh.p[indices[2]] - mesh.p[indices[0]], mesh.p[indices[1]] - mesh.p[indices[0]]);
+      if (n.lengthSquared() == 0) continue;
+      image[texel] = Spectrum(visibility(scene, p, normalize(n), u, arena));
+      arena.reset();
+    }
+  }, resolution.y);
+  return image;
+}
+
+}
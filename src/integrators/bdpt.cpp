@@ -0,0 +1,370 @@
+#include <nanopt/core/bsdf.h>
+#include <nanopt/core/stats.h>
+#include <nanopt/core/triangle.h>
+#include <nanopt/lights/diffuse.h>
+#include <nanopt/integrators/bdpt.h>
+
+namespace nanopt {
+
+namespace {
+
+enum class VertexType {
+  Camera,
+  Light,
+  Surface
+};
+
+// Vertex of a camera or light subpath. pdfFwd is the density it was
+// sampled with by the vertex before it on its own subpath and pdfRev the
+// density the vertex after it would sample it with, both per unit area,
+// which is all the balance heuristic needs to compare strategies.
+struct Vertex {
+  bool onSurface() const {
+    return isect.n.x != 0 || isect.n.y != 0 || isect.n.z != 0;
+  }
+
+  const Light* emitter() const {
+    if (type == VertexType::Light) return light;
+    if (type == VertexType::Surface) return isect.triangle->light;
+    return nullptr;
+  }
+
+  bool connectible() const {
+    if (type != VertexType::Surface) return true;
+    return isect.bsdf && !isect.bsdf->isDelta();
+  }
+
+  float convertDensity(float pdf, const Vertex& next) const {
+    auto w = next.isect.p - isect.p;
+    auto distance2 = w.lengthSquared();
+    if (distance2 == 0) return 0;
+    auto invDistance2 = 1 / distance2;
+    if (next.onSurface())
+      pdf *= absdot(next.isect.n, w * std::sqrt(invDistance2));
+    return pdf * invDistance2;
+  }
+
+  // Density per unit area of sampling next from this vertex, having
+  // arrived from prev.
+  float pdf(const Vertex* prev, const Vertex& next) const {
+    if (type == VertexType::Light) return pdfLight(next);
+    auto wn = next.isect.p - isect.p;
+    if (wn.lengthSquared() == 0) return 0;
+    wn = normalize(wn);
+
+    float pdf;
+    if (type == VertexType::Camera) {
+      float pdfPos;
+      camera->pdfWe(Ray(isect.p, wn), pdfPos, pdf);
+    } else {
+      pdf = isect.bsdf->pdf(normalize(prev->isect.p - isect.p), wn);
+    }
+    return convertDensity(pdf, next);
+  }
+
+  // Density of the light at this vertex emitting towards next.
+  float pdfLight(const Vertex& next) const {
+    auto w = next.isect.p - isect.p;
+    auto invDistance2 = 1 / w.lengthSquared();
+    w = w * std::sqrt(invDistance2);
+    float pdfPos, pdfDir;
+    emitter()->pdfLe(Ray(isect.p, w), isect.n, pdfPos, pdfDir);
+    auto pdf = pdfDir * invDistance2;
+    if (next.onSurface()) pdf *= absdot(next.isect.n, w);
+    return pdf;
+  }
+
+  // Density of a light subpath starting at this vertex, towards next.
+  float pdfLightOrigin(const Vertex& next, const LightSampler& lightDistribution) const {
+    auto w = normalize(next.isect.p - isect.p);
+    auto light = emitter();
+    float pdfPos, pdfDir;
+    light->pdfLe(Ray(isect.p, w), isect.n, pdfPos, pdfDir);
+    return pdfPos * lightDistribution.pmf(isect, *light);
+  }
+
+  Spectrum f(const Vertex& next, bool importance) const;
+
+  VertexType type;
+  Spectrum beta;
+  Interaction isect;
+  const Light* light;
+  const Camera* camera;
+  bool delta;
+  float pdfFwd, pdfRev;
+};
+
+Vertex* allocVertices(MemoryArena& arena, int n) {
+  auto vertices = (Vertex*)arena.alloc(sizeof(Vertex) * n, alignof(Vertex));
+  for (auto i = 0; i < n; ++i)
+    new (&vertices[i]) Vertex();
+  return vertices;
+}
+
+Vertex endpoint(VertexType type, const Vector3f& p, const Vector3f& n, const Spectrum& beta) {
+  Vertex v;
+  v.type = type;
+  v.beta = beta;
+  v.isect.p = p;
+  v.isect.n = n;
+  v.isect.ns = n;
+  v.light = nullptr;
+  v.camera = nullptr;
+  v.delta = false;
+  v.pdfFwd = v.pdfRev = 0;
+  return v;
+}
+
+Spectrum Vertex::f(const Vertex& next, bool importance) const {
+  auto wi = next.isect.p - isect.p;
+  if (wi.lengthSquared() == 0) return Spectrum(0);
+  wi = normalize(wi);
+  auto f = isect.bsdf->f(isect.wo, wi);
+  if (importance) f *= correctShadingNormal(isect, isect.wo, wi);
+  return f;
+}
+
+// Extends a subpath whose last vertex is path[-1] from ray, leaving up to
+// maxDepth vertices in path. Camera subpaths that leave the scene add the
+// environment to escaped.
+int randomWalk(
+    const Scene& scene, Ray ray, RenderContext& ctx,
+    Spectrum beta, float pdf, int maxDepth, bool importance,
+    Vertex* path, Spectrum* escaped) {
+
+  if (maxDepth == 0) return 0;
+  auto bounces = 0;
+  auto pdfFwd = pdf;
+  auto pdfRev = 0.0f;
+  while (true) {
+    auto& vertex = path[bounces];
+    auto& prev = path[bounces - 1];
+    auto& isect = vertex.isect;
+    if (!scene.intersect(ray, isect)) {
+      if (escaped && scene.infiniteLight)
+        *escaped += beta * scene.infiniteLight->le(ray);
+      break;
+    }
+
+    vertex.type = VertexType::Surface;
+    vertex.beta = beta;
+    vertex.light = nullptr;
+    vertex.camera = nullptr;
+    vertex.delta = false;
+    vertex.pdfFwd = prev.convertDensity(pdfFwd, vertex);
+    vertex.pdfRev = 0;
+    isect.computeScatteringFunctions(ctx.arena);
+    if (++bounces >= maxDepth || !isect.bsdf) break;
+
+    Vector3f wi;
+    float etaScale;
+    auto f = isect.bsdf->sample(ctx.sampler.get2D(), isect.wo, wi, pdfFwd, etaScale);
+    if (f.isBlack() || pdfFwd == 0) break;
+
+    beta *= f * absdot(wi, isect.ns) / pdfFwd;
+    // Refraction scales radiance by the squared ratio of the indices of
+    // refraction but leaves importance as it is.
+    if (importance) beta *= correctShadingNormal(isect, isect.wo, wi) * etaScale;
+
+    if (isect.bsdf->isDelta()) {
+      vertex.delta = true;
+      pdfFwd = pdfRev = 0;
+    } else {
+      pdfRev = isect.bsdf->pdf(wi, isect.wo);
+    }
+    prev.pdfRev = vertex.convertDensity(pdfRev, prev);
+    ray = isect.spawnRay(wi);
+  }
+  return bounces;
+}
+
+float geometry(const Scene& scene, const Vertex& a, const Vertex& b) {
+  auto d = a.isect.p - b.isect.p;
+  auto g = 1 / d.lengthSquared();
+  d = d * std::sqrt(g);
+  if (a.onSurface()) g *= absdot(a.isect.ns, d);
+  if (b.onSurface()) g *= absdot(b.isect.ns, d);
+  if (!VisibilityTester(a.isect, b.isect.p).unoccluded(scene)) return 0;
+  return g;
+}
+
+// Sets a value for the rest of the scope, restoring the old one after.
+template <typename T>
+class ScopedAssignment {
+public:
+  ScopedAssignment(T* target, const T& value) : target(target), backup() {
+    if (target) {
+      backup = *target;
+      *target = value;
+    }
+  }
+
+  ~ScopedAssignment() {
+    if (target) *target = backup;
+  }
+
+private:
+  T* target;
+  T backup;
+};
+
+float remap0(float f) {
+  return f != 0 ? f : 1;
+}
+
+// Balance heuristic weight of connecting light vertex s - 1 to camera
+// vertex t - 1, found by walking the path and turning each density ratio
+// into the one of the strategy with one more or one less vertex on the
+// camera side. Vertices touched by the connection are updated in place
+// for the duration.
+float misWeight(
+    Vertex* lightVertices, Vertex* cameraVertices,
+    const Vertex& sampled, int s, int t,
+    const LightSampler& lightDistribution) {
+
+  if (s + t == 2) return 1;
+
+  auto qs = s > 0 ? &lightVertices[s - 1] : nullptr;
+  auto pt = &cameraVertices[t - 1];
+  auto qsMinus = s > 1 ? &lightVertices[s - 2] : nullptr;
+  auto ptMinus = t > 1 ? &cameraVertices[t - 2] : nullptr;
+
+  ScopedAssignment<Vertex> a1(s == 1 ? qs : t == 1 ? pt : nullptr, sampled);
+  ScopedAssignment<bool> a2(&pt->delta, false);
+  ScopedAssignment<bool> a3(qs ? &qs->delta : nullptr, false);
+  ScopedAssignment<float> a4(&pt->pdfRev, s > 0
+    ? qs->pdf(qsMinus, *pt)
+    : pt->pdfLightOrigin(*ptMinus, lightDistribution));
+  ScopedAssignment<float> a5(ptMinus ? &ptMinus->pdfRev : nullptr, !ptMinus ? 0 : s > 0
+    ? pt->pdf(qs, *ptMinus)
+    : pt->pdfLight(*ptMinus));
+  ScopedAssignment<float> a6(qs ? &qs->pdfRev : nullptr, qs ? pt->pdf(ptMinus, *qs) : 0);
+  ScopedAssignment<float> a7(qsMinus ? &qsMinus->pdfRev : nullptr, qsMinus ? qs->pdf(pt, *qsMinus) : 0);
+
+  auto sumRi = 0.0f;
+  auto ri = 1.0f;
+  for (auto i = t - 1; i > 0; --i) {
+    ri *= remap0(cameraVertices[i].pdfRev) / remap0(cameraVertices[i].pdfFwd);
+    if (!cameraVertices[i].delta && !cameraVertices[i - 1].delta)
+      sumRi += ri;
+  }
+
+  ri = 1;
+  for (auto i = s - 1; i >= 0; --i) {
+    ri *= remap0(lightVertices[i].pdfRev) / remap0(lightVertices[i].pdfFwd);
+    auto deltaLightVertex = i > 0 ? lightVertices[i - 1].delta : lightVertices[0].light->isDelta();
+    if (!lightVertices[i].delta && !deltaLightVertex)
+      sumRi += ri;
+  }
+  return 1 / (1 + sumRi);
+}
+
+}
+
+void BDPTIntegrator::preprocess(const Scene& scene) {
+  Integrator::preprocess(scene);
+  // Light subpaths start on lights with a position, the environment being
+  // reached by camera subpaths alone.
+  std::vector<Light*> boundedLights;
+  for (auto light : scene.lights)
+    if (light->bounds()) boundedLights.push_back(light);
+  lightDistribution = createLightSampler(LightSampling::Power, boundedLights);
+}
+
+Spectrum BDPTIntegrator::li(const Ray& ray, const Scene& scene, RenderContext& ctx) const {
+  auto l = Spectrum(0);
+  auto cameraVertices = allocVertices(ctx.arena, maxDepth + 2);
+  auto lightVertices = allocVertices(ctx.arena, maxDepth + 1);
+
+  cameraVertices[0] = endpoint(VertexType::Camera, ray.o, Vector3f(0), Spectrum(1));
+  cameraVertices[0].camera = &camera;
+  float pdfPos, pdfDir;
+  camera.pdfWe(ray, pdfPos, pdfDir);
+  auto nCamera = 1 + randomWalk(scene, ray, ctx, Spectrum(1), pdfDir, maxDepth + 1, false, cameraVertices + 1, &l);
+  if (nCamera > 1 && ctx.aov) recordAOV(*ctx.aov, ray, cameraVertices[1].isect);
+
+  auto nLight = 0;
+  float lightPmf;
+  auto light = lightDistribution->sample(cameraVertices[0].isect, ctx.sampler.get1D(), lightPmf);
+  auto u1 = ctx.sampler.get2D();
+  auto u2 = ctx.sampler.get2D();
+  Ray lightRay(Vector3f(0), Vector3f(0));
+  Vector3f lightNormal;
+  auto le = light ? light->sampleLe(u1, u2, lightRay, lightNormal, pdfPos, pdfDir) : Spectrum(0);
+  if (!le.isBlack() && pdfPos > 0 && pdfDir > 0) {
+    lightVertices[0] = endpoint(VertexType::Light, lightRay.o, lightNormal, le);
+    lightVertices[0].light = light;
+    lightVertices[0].pdfFwd = pdfPos * lightPmf;
+    auto beta = le * absdot(lightNormal, lightRay.d) / (lightPmf * pdfPos * pdfDir);
+    nLight = 1 + randomWalk(scene, lightRay, ctx, beta, pdfDir, maxDepth, true, lightVertices + 1, nullptr);
+  }
+
+  for (auto t = 1; t <= nCamera; ++t) {
+    for (auto s = 0; s <= nLight; ++s) {
+      auto depth = s + t - 2;
+      if ((s == 1 && t == 1) || depth < 0 || depth > maxDepth) continue;
+
+      auto& pt = cameraVertices[t - 1];
+      auto contribution = Spectrum(0);
+      Vertex sampled;
+      Vector2f pRaster;
+
+      if (s == 0) {
+        // The camera subpath found a light on its own.
+        if (pt.type == VertexType::Surface && pt.emitter())
+          contribution = pt.beta * pt.isect.le(normalize(cameraVertices[t - 2].isect.p - pt.isect.p));
+      } else if (t == 1) {
+        // Light vertex connected to the camera, landing anywhere on the film.
+        auto& qs = lightVertices[s - 1];
+        if (!qs.connectible()) continue;
+        Vector3f wi;
+        float pdf;
+        VisibilityTester tester;
+        auto wiWeight = camera.sampleWi(qs.isect, ctx.sampler.get2D(), wi, pdf, pRaster, tester);
+        if (pdf == 0 || wiWeight.isBlack()) continue;
+        sampled = endpoint(VertexType::Camera, camera.frame.applyP(Vector3f(0)), Vector3f(0), wiWeight / pdf);
+        sampled.camera = &camera;
+        contribution = qs.beta * qs.f(sampled, true) * sampled.beta;
+        if (qs.onSurface()) contribution *= absdot(wi, qs.isect.ns);
+        if (!contribution.isBlack() && !tester.unoccluded(scene)) contribution = Spectrum(0);
+      } else if (s == 1) {
+        // Camera vertex connected to a freshly sampled light point.
+        if (!pt.connectible()) continue;
+        float pmf, pdf;
+        Interaction pLight;
+        auto sampledLight = lightDistribution->sample(pt.isect, ctx.sampler.get1D(), pmf);
+        auto u = ctx.sampler.get2D();
+        if (!sampledLight || !sampledLight->samplePoint(u, pLight, pdf) || pdf == 0) continue;
+        auto d = pLight.p - pt.isect.p;
+        auto distance2 = d.lengthSquared();
+        if (distance2 == 0) continue;
+        auto wi = d / std::sqrt(distance2);
+        auto li = sampledLight->l(pLight, -wi);
+        auto cosLight = pLight.n.x == 0 && pLight.n.y == 0 && pLight.n.z == 0 ? 1.0f : absdot(pLight.n, wi);
+        if (li.isBlack() || cosLight == 0) continue;
+
+        sampled = endpoint(VertexType::Light, pLight.p, pLight.n, li * cosLight / (pdf * pmf * distance2));
+        sampled.light = sampledLight;
+        sampled.pdfFwd = sampled.pdfLightOrigin(pt, *lightDistribution);
+        contribution = pt.beta * pt.f(sampled, false) * sampled.beta * absdot(wi, pt.isect.ns);
+        if (!contribution.isBlack() && !VisibilityTester(pt.isect, pLight.p).unoccluded(scene))
+          contribution = Spectrum(0);
+      } else {
+        auto& qs = lightVertices[s - 1];
+        if (!qs.connectible() || !pt.connectible()) continue;
+        contribution = qs.beta * qs.f(pt, true) * pt.f(qs, false) * pt.beta;
+        if (!contribution.isBlack()) contribution *= geometry(scene, qs, pt);
+      }
+
+      if (contribution.isBlack()) continue;
+      contribution *= misWeight(lightVertices, cameraVertices, sampled, s, t, *lightDistribution);
+      if (t == 1)
+        camera.film.addSplat(pRaster, contribution);
+      else
+        l += contribution;
+    }
+  }
+  return l;
+}
+
+}
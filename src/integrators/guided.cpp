@@ -0,0 +1,136 @@
+#include <cmath>
+#include <nanopt/core/bsdf.h>
+#include <nanopt/core/stats.h>
+#include <nanopt/integrators/guided.h>
+
+namespace nanopt {
+
+namespace {
+
+// Scattering vertex of a path whose incident radiance along wi is recorded
+// into the SDTree once the path is done.
+struct GuidingVertex {
+  Vector3f p;
+  Vector3f wi;
+  // Throughput up to and including the scattering at this vertex, which
+  // contributions found further along the path are divided by.
+  Spectrum beta;
+  Spectrum radiance;
+  float pdf;
+};
+
+}
+
+void GuidedPathIntegrator::preprocess(const Scene& scene) {
+  PathIntegrator::preprocess(scene);
+  sdTree.reset(new SDTree(scene.accel.getBounds()));
+}
+
+void GuidedPathIntegrator::renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas) {
+
+  PathIntegrator::renderPass(scene, pass, nSamples, arenas);
+
+  // Training iterations double in length, passes 0, 1-2, 3-6 and so on,
+  // so each learns from as many samples as all the ones before it.
+  auto nextPass = pass + 1;
+  if ((nextPass & (nextPass + 1)) != 0) return;
+  auto iterationSamples = (nextPass + 1) / 2 * nSamples;
+  sdTree->refine((int)(spatialThreshold * std::sqrt((float)iterationSamples)), directionalThreshold);
+}
+
+Spectrum GuidedPathIntegrator::li(const Ray& ray, const Scene& scene, RenderContext& ctx) const {
+  Ray r(ray);
+  auto etaScaleFix = 1.0f;
+  auto specularBounce = false;
+  Spectrum l(0), beta(1), rrBeta(1);
+  auto bounce = 0;
+
+  auto vertices = (GuidingVertex*)ctx.arena.alloc(sizeof(GuidingVertex) * maxDepth, alignof(GuidingVertex));
+  auto nVertices = 0;
+  auto addRadiance = [&](const Spectrum& contribution) {
+    l += contribution;
+    for (auto i = 0; i < nVertices; ++i) {
+      auto& v = vertices[i];
+      for (auto c = 0; c < 3; ++c)
+        if (v.beta[c] > 0) v.radiance[c] += contribution[c] / v.beta[c];
+    }
+  };
+
+  for (; bounce < maxDepth; ++bounce) {
+    Interaction isect;
+    auto foundIntersection = scene.intersect(r, isect);
+
+    if (bounce == 0 || specularBounce) {
+      if (foundIntersection)
+        addRadiance(beta * isect.le(-r.d));
+      else if (scene.infiniteLight)
+        addRadiance(beta * scene.infiniteLight->le(r));
+    }
+
+    if (!foundIntersection) break;
+    isect.computeScatteringFunctions(ctx.arena);
+    if (bounce == 0 && ctx.aov) recordAOV(*ctx.aov, r, isect);
+    if (!isect.bsdf) break;
+    addRadiance(beta * sampleOneLight(isect, scene, ctx));
+
+    // One sample MIS between the BSDF and the learned distribution, the
+    // pdf of the direction being the mix of both whichever picked it.
+    auto& bsdf = *isect.bsdf;
+    auto& guide = sdTree->sampling(isect.p);
+    auto guided = !bsdf.isDelta() && !guide.empty();
+    float etaScale = 1;
+    float scatteringPdf;
+    Vector3f wi, wo = -r.d;
+    Spectrum f;
+    if (!guided) {
+      f = bsdf.sample(ctx.sampler.get2D(), wo, wi, scatteringPdf, etaScale);
+    } else {
+      auto u = ctx.sampler.get1D();
+      auto uDirection = ctx.sampler.get2D();
+      float bsdfPdf;
+      if (u < bsdfSamplingFraction) {
+        f = bsdf.sample(uDirection, wo, wi, bsdfPdf, etaScale);
+      } else {
+        wi = guide.sample(uDirection);
+        f = bsdf.f(wo, wi);
+        bsdfPdf = bsdf.pdf(wo, wi);
+      }
+      scatteringPdf = bsdfSamplingFraction * bsdfPdf + (1 - bsdfSamplingFraction) * guide.pdf(wi);
+    }
+
+    if (f.isBlack() || scatteringPdf == 0) break;
+
+    beta *= f * absdot(isect.ns, wi) / scatteringPdf;
+    etaScaleFix *= etaScale;
+    rrBeta = beta * etaScaleFix;
+    specularBounce = bsdf.isDelta();
+    r = isect.spawnRay(wi);
+    if (!specularBounce)
+      vertices[nVertices++] = { isect.p, wi, beta, Spectrum(0), scatteringPdf };
+
+    if (rrBeta.maxComponent() < 1.0f && bounce > 3) {
+      auto q = std::max(0.05f, 1 - rrBeta.maxComponent());
+      if (ctx.sampler.get1D() < q) {
+        NANOPT_STAT_INC_TO(ctx.stats, RussianRouletteTerminations);
+        break;
+      }
+      beta /= 1 - q;
+    }
+  }
+
+  NANOPT_STAT_REPORT_TO(ctx.stats, PathLength, bounce);
+
+  for (auto i = 0; i < nVertices; ++i) {
+    auto& v = vertices[i];
+    auto energy = v.radiance.y() / v.pdf;
+    if (std::isfinite(energy) && energy > 0)
+      sdTree->record(v.p, v.wi, energy);
+  }
+
+  return l;
+}
+
+}
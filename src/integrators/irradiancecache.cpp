@@ -0,0 +1,161 @@
+#include <cmath>
+#include <vector>
+#include <nanopt/core/bsdf.h>
+#include <nanopt/core/frame.h>
+#include <nanopt/core/stats.h>
+#include <nanopt/integrators/irradiancecache.h>
+
+namespace nanopt {
+
+void IrradianceCacheIntegrator::preprocess(const Scene& scene) {
+  PathIntegrator::preprocess(scene);
+  auto bounds = scene.accel.getBounds();
+  sceneDiagonal = bounds.diag().length();
+  cache.reset(new IrradianceCache(bounds));
+}
+
+Spectrum IrradianceCacheIntegrator::li(const Ray& ray, const Scene& scene, RenderContext& ctx) const {
+  Ray r(ray);
+  Spectrum l(0), beta(1);
+
+  for (auto bounce = 0; bounce < maxDepth; ++bounce) {
+    Interaction isect;
+    if (!scene.intersect(r, isect)) {
+      if (scene.infiniteLight) l += beta * scene.infiniteLight->le(r);
+      break;
+    }
+
+    // Only specular bounces get here after the first hit, so emission is
+    // never found by direct lighting as well.
+    l += beta * isect.le(-r.d);
+    isect.computeScatteringFunctions(ctx.arena);
+    if (bounce == 0 && ctx.aov) recordAOV(*ctx.aov, r, isect);
+    if (!isect.bsdf) break;
+
+    auto& bsdf = *isect.bsdf;
+    if (!bsdf.isDelta()) {
+      l += beta * sampleOneLight(isect, scene, ctx);
+      // Records face the side they were seen from, so both sides of thin
+      // surfaces get their own.
+      auto n = dot(isect.ns, isect.wo) < 0 ? -isect.ns : isect.ns;
+      Spectrum e;
+      if (!cache->interpolate(isect.p, n, maxError, e)) {
+        auto record = computeRecord(isect, n, scene, ctx);
+        cache->add(record, maxError);
+        e = record.e;
+      }
+      l += beta * bsdf.albedo() * InvPi * e;
+      break;
+    }
+
+    Vector3f wi;
+    float pdf, etaScale;
+    auto f = bsdf.sample(ctx.sampler.get2D(), isect.wo, wi, pdf, etaScale);
+    if (f.isBlack() || pdf == 0) break;
+    beta *= f * absdot(isect.ns, wi) / pdf;
+    r = isect.spawnRay(wi);
+  }
+  return l;
+}
+
+IrradianceRecord IrradianceCacheIntegrator::computeRecord(
+    const Interaction& isect, const Vector3f& n,
+    const Scene& scene, RenderContext& ctx) const {
+
+  // Cosine weighted directions stratified in sin^2 theta and phi, the
+  // layout Ward and Heckbert's gradient estimates are written for.
+  auto nTheta = nThetaSamples;
+  auto nPhi = std::max(1, (int)std::round(Pi * nTheta));
+  std::vector<Spectrum> l(nTheta * nPhi);
+  std::vector<float> hitDistance(nTheta * nPhi);
+  std::vector<float> sinTheta(nTheta * nPhi);
+  std::vector<float> cosTheta(nTheta * nPhi);
+  std::vector<float> phi(nTheta * nPhi);
+
+  // Indirect light only, direct light being sampled at every shading point.
+  auto aov = ctx.aov;
+  ctx.aov = nullptr;
+  Frame frame(n);
+  auto invDistanceSum = 0.0f;
+  for (auto j = 0; j < nTheta; ++j) {
+    for (auto k = 0; k < nPhi; ++k) {
+      auto i = j * nPhi + k;
+      auto u = ctx.sampler.get2D();
+      auto sin2Theta = (j + u[0]) / nTheta;
+      sinTheta[i] = std::sqrt(sin2Theta);
+      cosTheta[i] = std::sqrt(std::max(0.0f, 1 - sin2Theta));
+      phi[i] = 2 * Pi * (k + u[1]) / nPhi;
+      auto w = frame.toWorld(sphericalDirection(sinTheta[i], cosTheta[i], phi[i]));
+      auto ray = isect.spawnRay(w);
+
+      // Intersecting shortens the ray, so li gets a fresh one.
+      // The environment is direct light too, so escaping rays bring none.
+      Interaction hit;
+      if (!scene.intersect(ray, hit)) {
+        hitDistance[i] = Infinity;
+        l[i] = Spectrum(0);
+        continue;
+      }
+      hitDistance[i] = std::max(distance(isect.p, hit.p), 1e-6f);
+      invDistanceSum += 1 / hitDistance[i];
+      l[i] = PathIntegrator::li(isect.spawnRay(w), scene, ctx) - hit.le(-w);
+    }
+  }
+  ctx.aov = aov;
+
+  IrradianceRecord record;
+  record.p = isect.p;
+  record.n = n;
+  record.e = Spectrum(0);
+  for (auto& li : l)
+    record.e += li;
+  record.e *= Pi / (nTheta * nPhi);
+
+  // Rotation gradient from the change of the cosine weights, translation
+  // gradient from the change of the cells' solid angles and boundaries
+  // as the point moves, per Ward and Heckbert.
+  for (auto c = 0; c < 3; ++c) {
+    auto rotation = Vector3f(0, 0, 0);
+    auto translation = Vector3f(0, 0, 0);
+    for (auto k = 0; k < nPhi; ++k) {
+      auto phiK = 2 * Pi * k / nPhi;
+      auto uK = Vector3f(std::cos(phiK), std::sin(phiK), 0);
+      auto vK = Vector3f(-std::sin(phiK), std::cos(phiK), 0);
+      auto kPrev = (k + nPhi - 1) % nPhi;
+
+      for (auto j = 0; j < nTheta; ++j) {
+        auto i = j * nPhi + k;
+        auto tanTheta = cosTheta[i] > 0 ? sinTheta[i] / cosTheta[i] : 0;
+        rotation = rotation + Vector3f(-std::sin(phi[i]), std::cos(phi[i]), 0) * (-tanTheta * l[i][c]);
+
+        auto sinThetaMinus = std::sqrt((float)j / nTheta);
+        auto cosThetaMinus = std::sqrt(1 - (float)j / nTheta);
+        auto cosThetaPlus = std::sqrt(std::max(0.0f, 1 - (float)(j + 1) / nTheta));
+        if (j > 0) {
+          auto rMin = std::min(hitDistance[i], hitDistance[i - nPhi]);
+          translation = translation + uK * (2 * Pi / nPhi * sinThetaMinus * cosThetaMinus * cosThetaMinus / rMin * (l[i][c] - l[i - nPhi][c]));
+        }
+        auto rMin = std::min(hitDistance[i], hitDistance[j * nPhi + kPrev]);
+        if (sinTheta[i] > 0)
+          translation = translation + vK * ((cosThetaMinus - cosThetaPlus) / (sinTheta[i] * rMin) * (l[i][c] - l[j * nPhi + kPrev][c]));
+      }
+    }
+    record.rotationGradient[c] = frame.toWorld(rotation * (Pi / (nTheta * nPhi)));
+    record.translationGradient[c] = frame.toWorld(translation);
+  }
+
+  // Harmonic mean distance, shortened where the translation gradient says
+  // irradiance changes faster than the distance would suggest.
+  auto radius = invDistanceSum > 0 ? nTheta * nPhi / invDistanceSum : Infinity;
+  auto y = record.e.y();
+  auto gradient = record.translationGradient[0] * 0.212671f +
+    record.translationGradient[1] * 0.715160f +
+    record.translationGradient[2] * 0.072169f;
+  if (gradient.length() > 0 && y > 0)
+    radius = std::min(radius, y / gradient.length());
+  record.radius = clamp(radius, minSpacing * sceneDiagonal, maxSpacing * sceneDiagonal);
+  NANOPT_STAT_INC_TO(ctx.stats, IrradianceRecords);
+  return record;
+}
+
+}
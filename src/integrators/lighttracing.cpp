@@ -0,0 +1,101 @@
+#include <nanopt/core/bsdf.h>
+#include <nanopt/core/stats.h>
+#include <nanopt/integrators/lighttracing.h>
+
+namespace nanopt {
+
+void LightTracingIntegrator::preprocess(const Scene& scene) {
+  Integrator::preprocess(scene);
+  lightDistribution = createLightSampler(LightSampling::Power, scene.lights);
+}
+
+void LightTracingIntegrator::splatToCamera(
+    const Interaction& isect, const Spectrum& beta,
+    const Scene& scene, RenderContext& ctx) const {
+
+  Vector3f wi;
+  float pdf;
+  Vector2f pRaster;
+  VisibilityTester tester;
+  auto we = camera.sampleWi(isect, ctx.sampler.get2D(), wi, pdf, pRaster, tester);
+  if (pdf == 0 || we.isBlack()) return;
+
+  auto f = isect.bsdf->f(isect.wo, wi) * correctShadingNormal(isect, isect.wo, wi);
+  auto contribution = beta * f * we * absdot(wi, isect.ns) / pdf;
+  if (!contribution.isBlack() && tester.unoccluded(scene))
+    camera.film.addSplat(pRaster, contribution);
+}
+
+Spectrum LightTracingIntegrator::li(const Ray& ray, const Scene& scene, RenderContext& ctx) const {
+  // Light paths never reach the camera from an environment light, the
+  // camera ray has to see it.
+  auto l = Spectrum(0);
+  if (scene.infiniteLight && !scene.intersect(ray))
+    l = scene.infiniteLight->le(ray);
+
+  float lightPmf;
+  Interaction ref;
+  auto light = lightDistribution->sample(ref, ctx.sampler.get1D(), lightPmf);
+  auto u1 = ctx.sampler.get2D();
+  auto u2 = ctx.sampler.get2D();
+  if (!light || lightPmf == 0) return l;
+
+  Ray r(Vector3f(0), Vector3f(0));
+  Vector3f nLight;
+  float pdfPos, pdfDir;
+  auto le = light->sampleLe(u1, u2, r, nLight, pdfPos, pdfDir);
+  if (le.isBlack() || pdfPos == 0 || pdfDir == 0) return l;
+
+  // Emitters seen directly, connecting the light's own point to the
+  // camera. Point lights cover no area of the film, as for the other
+  // integrators, and environment lights start their paths off a disk
+  // that is not part of the scene.
+  if (!light->isDelta() && light->bounds()) {
+    Interaction pLight;
+    pLight.p = r.o;
+    pLight.n = nLight;
+    Vector3f wi;
+    float pdf;
+    Vector2f pRaster;
+    VisibilityTester tester;
+    auto we = camera.sampleWi(pLight, ctx.sampler.get2D(), wi, pdf, pRaster, tester);
+    if (pdf > 0 && !we.isBlack()) {
+      auto contribution = light->l(pLight, wi) * absdot(nLight, wi) * we / (pdf * pdfPos * lightPmf);
+      if (!contribution.isBlack() && tester.unoccluded(scene))
+        camera.film.addSplat(pRaster, contribution);
+    }
+  }
+
+  auto beta = le * absdot(nLight, r.d) / (lightPmf * pdfPos * pdfDir);
+  for (auto bounce = 0; bounce < maxDepth; ++bounce) {
+    Interaction isect;
+    if (!scene.intersect(r, isect)) break;
+    isect.computeScatteringFunctions(ctx.arena);
+    if (!isect.bsdf) break;
+
+    auto& bsdf = *isect.bsdf;
+    if (!bsdf.isDelta())
+      splatToCamera(isect, beta, scene, ctx);
+
+    Vector3f wi;
+    float pdf, etaScale;
+    auto f = bsdf.sample(ctx.sampler.get2D(), isect.wo, wi, pdf, etaScale);
+    if (f.isBlack() || pdf == 0) break;
+    // Refraction scales radiance by the squared ratio of the indices of
+    // refraction but leaves importance as it is.
+    beta *= f * absdot(wi, isect.ns) * correctShadingNormal(isect, isect.wo, wi) * etaScale / pdf;
+    r = isect.spawnRay(wi);
+
+    if (beta.maxComponent() < 1.0f && bounce > 3) {
+      auto q = std::max(0.05f, 1 - beta.maxComponent());
+      if (ctx.sampler.get1D() < q) {
+        NANOPT_STAT_INC_TO(ctx.stats, RussianRouletteTerminations);
+        break;
+      }
+      beta /= 1 - q;
+    }
+  }
+  return l;
+}
+
+}
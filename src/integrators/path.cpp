@@ -1,5 +1,6 @@
 #include <memory>
 #include <nanopt/core/bsdf.h>
+#include <nanopt/core/stats.h>
 #include <nanopt/core/triangle.h>
 #include <nanopt/core/visibilitytester.h>
 #include <nanopt/lights/infinite.h>
@@ -7,13 +8,14 @@
 
 namespace nanopt {
 
-Spectrum PathIntegrator::li(const Ray& ray, const Scene& scene) const {
+Spectrum PathIntegrator::li(const Ray& ray, const Scene& scene, RenderContext& ctx) const {
   Ray r(ray);
   auto etaScaleFix = 1.0f;
   auto specularBounce = false;
   Spectrum l(0), beta(1), rrBeta(1);
+  auto bounce = 0;
 
-  for (auto bounce = 0; bounce < maxDepth; ++bounce) {
+  for (; bounce < maxDepth; ++bounce) {
     Interaction isect;
     auto foundIntersection = scene.intersect(r, isect);
 
@@ -25,14 +27,15 @@ Spectrum PathIntegrator::li(const Ray& ray, const Scene& scene) const {
     }
 
     if (!foundIntersection) break;
-    isect.computeScatteringFunctions();
+    isect.computeScatteringFunctions(ctx.arena);
+    if (bounce == 0 && ctx.aov) recordAOV(*ctx.aov, r, isect);
     if (!isect.bsdf) break;
-    l += beta * sampleOneLight(isect, scene);
+    l += beta * sampleOneLight(isect, scene, ctx);
 
     float etaScale;
     float scatteringPdf;
     Vector3f wi, wo = -r.d;
-    auto f = isect.bsdf->sample(sampler.get2D(), wo, wi, scatteringPdf, etaScale);
+    auto f = isect.bsdf->sample(ctx.sampler.get2D(), wo, wi, scatteringPdf, etaScale);
 
     if (f.isBlack()) break;
 
@@ -44,23 +47,29 @@ Spectrum PathIntegrator::li(const Ray& ray, const Scene& scene) const {
 
     if (rrBeta.maxComponent() < 1.0f && bounce > 3) {
       auto q = std::max(0.05f, 1 - rrBeta.maxComponent());
-      if (sampler.get1D() < q) break;
+      if (ctx.sampler.get1D() < q) {
+        NANOPT_STAT_INC_TO(ctx.stats, RussianRouletteTerminations);
+        break;
+      }
       beta /= 1 - q;
     }
   }
 
+  NANOPT_STAT_REPORT_TO(ctx.stats, PathLength, bounce);
+
   return l;
 }
 
 Spectrum PathIntegrator::estimateDirect(
   const Interaction& isect,
   const Light& light,
-  const Scene& scene) const {
+  const Scene& scene,
+  RenderContext& ctx) const {
 
   Vector3f wi;
   float lightPdf;
   VisibilityTester tester;
-  auto li = light.sample(isect, sampler.get2D(), wi, lightPdf, tester);
+  auto li = light.sample(isect, ctx.sampler.get2D(), wi, lightPdf, tester);
   if (li.isBlack()) return Spectrum(0);
 
   auto ld = Spectrum(0);
@@ -75,7 +84,7 @@ Spectrum PathIntegrator::estimateDirect(
   if (!light.isDelta() && !isect.bsdf->isDelta()) {
     float etaScale;
     float scatteringPdf;
-    f = isect.bsdf->sample(sampler.get2D(), isect.wo, wi, scatteringPdf, etaScale);
+    f = isect.bsdf->sample(ctx.sampler.get2D(), isect.wo, wi, scatteringPdf, etaScale);
     f *= absdot(isect.ns, wi);
 
     if (!f.isBlack()) {
@@ -89,8 +98,8 @@ Spectrum PathIntegrator::estimateDirect(
       if (foundIntersection) {
         if ((Light*)lightIsect.triangle->light == &light)
           li = lightIsect.le(-wi);
-      } else {
-        li = ((InfiniteAreaLight*)&light)->le(ray);
+      } else if (&light == scene.infiniteLight) {
+        li = scene.infiniteLight->le(ray);
       }
 
       if (!li.isBlack()) {
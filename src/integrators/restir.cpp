@@ -0,0 +1,293 @@
+#include <nanopt/core/bsdf.h>
+#include <nanopt/core/stats.h>
+#include <nanopt/core/parallel.h>
+#include <nanopt/core/sampling.h>
+#include <nanopt/core/visibilitytester.h>
+#include <nanopt/integrators/restir.h>
+
+namespace nanopt {
+
+namespace {
+
+enum class Stage {
+  Candidates,
+  Spatial,
+  Shade
+};
+
+// Surfaces further apart than this are not reused from, as their lighting
+// differs too much for the reused samples to be any good.
+constexpr auto MinNormalCosine = 0.9f;
+constexpr auto MaxRelativeDepth = 0.1f;
+// History is capped at this many times the candidates of one sample, so
+// that old samples do not dominate when the lighting they saw was poor.
+constexpr auto MaxHistory = 20;
+
+// Unshadowed contribution of the light point (light, p, n) to isect.
+Spectrum unshadowed(const Interaction& isect, const Light& light, const Vector3f& p, const Vector3f& n) {
+  auto d = p - isect.p;
+  auto distance2 = d.lengthSquared();
+  if (distance2 == 0) return Spectrum(0);
+  auto wi = d / std::sqrt(distance2);
+
+  Interaction pLight;
+  pLight.p = p;
+  pLight.n = n;
+  auto le = light.l(pLight, -wi);
+  if (le.isBlack()) return Spectrum(0);
+
+  auto cosLight = n.x == 0 && n.y == 0 && n.z == 0 ? 1.0f : absdot(n, wi);
+  return isect.bsdf->f(isect.wo, wi) * le * (absdot(isect.ns, wi) * cosLight / distance2);
+}
+
+bool similar(const Interaction& a, float depthA, const Interaction& b, float depthB) {
+  return dot(a.ns, b.ns) >= MinNormalCosine && std::abs(depthA - depthB) <= MaxRelativeDepth * depthA;
+}
+
+}
+
+void ReSTIRDirectIntegrator::preprocess(const Scene& scene) {
+  Integrator::preprocess(scene);
+
+  std::vector<Light*> boundedLights;
+  unboundedLights.clear();
+  for (auto light : scene.lights) {
+    if (light->bounds()) boundedLights.push_back(light);
+    else unboundedLights.push_back(light);
+  }
+  candidateSampler = createLightSampler(options.lightSampling, boundedLights);
+
+  history.clear();
+  for (auto& s : surfaces)
+    s.clear();
+}
+
+ReSTIRDirectIntegrator::Reservoir ReSTIRDirectIntegrator::sampleCandidates(
+    const Interaction& isect, Sampler& sampler) const {
+
+  Reservoir r;
+  r.M = nCandidates;
+  for (auto i = 0; i < nCandidates; ++i) {
+    float lightPmf, pdf;
+    Interaction pLight;
+    auto light = candidateSampler->sample(isect, sampler.get1D(), lightPmf);
+    auto u = sampler.get2D();
+    auto uSelect = sampler.get1D();
+    if (!light || !light->samplePoint(u, pLight, pdf) || pdf == 0) continue;
+    auto pHat = unshadowed(isect, *light, pLight.p, pLight.n).y();
+    r.update(light, pLight, pHat / (lightPmf * pdf), uSelect);
+  }
+
+  if (r.light) {
+    auto pHat = unshadowed(isect, *r.light, r.p, r.n).y();
+    r.W = pHat > 0 ? r.wSum / (r.M * pHat) : 0;
+  }
+  return r;
+}
+
+ReSTIRDirectIntegrator::Reservoir ReSTIRDirectIntegrator::combine(
+    const Surface* const* domains,
+    const Reservoir* const* reservoirs,
+    int n, Sampler& sampler) const {
+
+  Reservoir r;
+  auto& isect = domains[0]->isect;
+  for (auto i = 0; i < n; ++i) {
+    auto& ri = *reservoirs[i];
+    auto u = sampler.get1D();
+    r.M += ri.M;
+    if (!ri.light || ri.W == 0) continue;
+    Interaction pLight;
+    pLight.p = ri.p;
+    pLight.n = ri.n;
+    auto pHat = unshadowed(isect, *ri.light, ri.p, ri.n).y();
+    r.update(ri.light, pLight, pHat * ri.W * ri.M, u);
+  }
+  if (!r.light) return r;
+
+  // Only the domains that could have produced the chosen sample count
+  // towards its weight.
+  auto z = 0;
+  for (auto i = 0; i < n; ++i)
+    if (unshadowed(domains[i]->isect, *r.light, r.p, r.n).y() > 0)
+      z += reservoirs[i]->M;
+
+  auto pHat = unshadowed(isect, *r.light, r.p, r.n).y();
+  r.W = z > 0 && pHat > 0 ? r.wSum / (z * pHat) : 0;
+  return r;
+}
+
+Spectrum ReSTIRDirectIntegrator::shade(
+    const Interaction& isect, const Reservoir& r, const Scene& scene, Sampler& sampler) const {
+
+  auto l = Spectrum(0);
+  if (r.light && r.W > 0) {
+    auto c = unshadowed(isect, *r.light, r.p, r.n);
+    if (!c.isBlack() && VisibilityTester(isect, r.p).unoccluded(scene))
+      l += c * r.W;
+  }
+
+  for (auto light : unboundedLights) {
+    Vector3f wi;
+    float pdf;
+    VisibilityTester tester;
+    auto li = light->sample(isect, sampler.get2D(), wi, pdf, tester);
+    if (pdf == 0 || li.isBlack()) continue;
+    auto f = isect.bsdf->f(isect.wo, wi) * absdot(isect.ns, wi);
+    if (!f.isBlack() && tester.unoccluded(scene))
+      l += f * li / pdf;
+  }
+  return l;
+}
+
+Spectrum ReSTIRDirectIntegrator::li(const Ray& ray, const Scene& scene, RenderContext& ctx) const {
+  Interaction isect;
+  if (!scene.intersect(ray, isect))
+    return scene.infiniteLight ? scene.infiniteLight->le(ray) : Spectrum(0);
+
+  auto l = isect.le(-ray.d);
+  isect.computeScatteringFunctions(ctx.arena);
+  if (ctx.aov) recordAOV(*ctx.aov, ray, isect);
+  if (!isect.bsdf) return l;
+
+  auto r = sampleCandidates(isect, ctx.sampler);
+  return l + shade(isect, r, scene, ctx.sampler);
+}
+
+void ReSTIRDirectIntegrator::renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas) {
+
+  auto& film = camera.film;
+  auto bounds = renderBounds();
+  auto diag = bounds.diag();
+  auto nPixels = film.pixelBounds.area();
+
+  for (auto& a : surfaceArenas) {
+    a.resize(parallelThreadCount());
+    for (auto& arena : a)
+      if (!arena) arena.reset(new MemoryArena());
+  }
+  if ((int)history.size() != nPixels) {
+    history.assign(nPixels, Reservoir());
+    for (auto& s : surfaces)
+      s.assign(nPixels, Surface());
+  }
+
+  std::vector<Reservoir> reservoirs(nPixels), final(nPixels);
+  std::vector<Vector2f> pFilm(nPixels);
+  std::vector<Spectrum> l(nPixels);
+  std::vector<AOVSample> aovs(film.aovs ? nPixels : 0);
+
+  for (auto sample = 0; sample < nSamples; ++sample) {
+    auto previous = current;
+    current ^= 1;
+    for (auto& arena : surfaceArenas[current])
+      arena->reset();
+
+    // Camera rays, initial candidates and temporal reuse.
+    parallelFor([&](std::int64_t y) {
+      auto rowSampler = sampler.clone(streamSeed({ pass, sample, (int)Stage::Candidates, bounds.pMin.y + y }));
+      auto& s = *rowSampler;
+      auto& arena = *surfaceArenas[current][parallelThreadIndex()];
+
+      for (auto x = 0; x < diag.x; ++x) {
+        Vector2i p(bounds.pMin.x + x, bounds.pMin.y + (int)y);
+        auto index = film.pixelIndex(p);
+        auto& surface = surfaces[current][index];
+        surface.valid = false;
+        reservoirs[index] = Reservoir();
+        l[index] = Spectrum(0);
+        if (!isPixelActive(p)) continue;
+
+        auto cameraSample = s.getCameraSample(p);
+        auto ray = camera.generateRay(cameraSample);
+        NANOPT_STAT_INC(CameraRays);
+        pFilm[index] = cameraSample.pFilm;
+        if (film.aovs) aovs[index] = AOVSample();
+
+        auto& isect = surface.isect;
+        if (!scene.intersect(ray, isect)) {
+          if (scene.infiniteLight) l[index] = scene.infiniteLight->le(ray);
+          continue;
+        }
+        l[index] = isect.le(-ray.d);
+        isect.computeScatteringFunctions(arena);
+        if (film.aovs) recordAOV(aovs[index], ray, isect);
+        if (!isect.bsdf) continue;
+
+        surface.depth = distance(ray.o, isect.p);
+        surface.valid = true;
+        reservoirs[index] = sampleCandidates(isect, s);
+
+        auto& prevSurface = surfaces[previous][index];
+        auto& prevReservoir = history[index];
+        if (!temporalReuse || !prevSurface.valid || prevReservoir.M == 0 ||
+            !similar(isect, surface.depth, prevSurface.isect, prevSurface.depth))
+          continue;
+
+        auto prev = prevReservoir;
+        prev.M = std::min(prev.M, MaxHistory * nCandidates);
+        const Surface* domains[2] = { &surface, &prevSurface };
+        const Reservoir* merged[2] = { &reservoirs[index], &prev };
+        reservoirs[index] = combine(domains, merged, 2, s);
+      }
+    }, diag.y);
+
+    // Spatial reuse, reading the reservoirs above and writing final.
+    parallelFor([&](std::int64_t y) {
+      auto rowSampler = sampler.clone(streamSeed({ pass, sample, (int)Stage::Spatial, bounds.pMin.y + y }));
+      auto& s = *rowSampler;
+      std::vector<const Surface*> domains;
+      std::vector<const Reservoir*> merged;
+
+      for (auto x = 0; x < diag.x; ++x) {
+        Vector2i p(bounds.pMin.x + x, bounds.pMin.y + (int)y);
+        auto index = film.pixelIndex(p);
+        auto& surface = surfaces[current][index];
+        final[index] = reservoirs[index];
+        if (!surface.valid || nSpatialNeighbors == 0) continue;
+
+        domains.assign(1, &surface);
+        merged.assign(1, &reservoirs[index]);
+        for (auto i = 0; i < nSpatialNeighbors; ++i) {
+          auto offset = uniformSampleDisk(s.get2D()) * spatialRadius;
+          Vector2i q(p.x + (int)std::round(offset.x), p.y + (int)std::round(offset.y));
+          if (q == p || q.x < bounds.pMin.x || q.x >= bounds.pMax.x || q.y < bounds.pMin.y || q.y >= bounds.pMax.y)
+            continue;
+          auto neighbor = film.pixelIndex(q);
+          auto& other = surfaces[current][neighbor];
+          if (!other.valid || !similar(surface.isect, surface.depth, other.isect, other.depth))
+            continue;
+          domains.push_back(&other);
+          merged.push_back(&reservoirs[neighbor]);
+        }
+        if (domains.size() > 1)
+          final[index] = combine(domains.data(), merged.data(), (int)domains.size(), s);
+      }
+    }, diag.y);
+
+    parallelFor([&](std::int64_t y) {
+      auto rowSampler = sampler.clone(streamSeed({ pass, sample, (int)Stage::Shade, bounds.pMin.y + y }));
+      for (auto x = 0; x < diag.x; ++x) {
+        auto index = film.pixelIndex(Vector2i(bounds.pMin.x + x, bounds.pMin.y + (int)y));
+        auto& surface = surfaces[current][index];
+        history[index] = surface.valid ? reservoirs[index] : Reservoir();
+        if (surface.valid)
+          l[index] += shade(surface.isect, final[index], scene, *rowSampler);
+      }
+    }, diag.y);
+
+    // Filtered samples overlap neighboring pixels, so they are added on
+    // this thread, which also keeps the sums independent of scheduling.
+    for (auto p : bounds) {
+      if (!isPixelActive(p)) continue;
+      auto index = film.pixelIndex(p);
+      film.addSample(pFilm[index], l[index]);
+      if (film.aovs) film.addAOVSample(pFilm[index], aovs[index]);
+    }
+  }
+}
+
+}
@@ -0,0 +1,270 @@
+#include <nanopt/core/bsdf.h>
+#include <nanopt/core/stats.h>
+#include <nanopt/integrators/sppm.h>
+
+namespace nanopt {
+
+namespace {
+
+enum class Stage {
+  Camera,
+  Photons
+};
+
+// Photons are shot in chunks of this many, each drawing from a sampler of
+// its own so the photons do not depend on scheduling.
+constexpr auto PhotonChunkSize = 4096;
+
+// Visible points overlapping a grid cell, pushed onto the cell's list
+// with a compare and swap so threads can insert without locks.
+template <typename Pixel>
+struct GridNode {
+  Pixel* pixel;
+  GridNode* next;
+};
+
+std::uint32_t hashCell(const Vector3i& p, int hashSize) {
+  return ((std::uint32_t)p.x * 73856093u ^ (std::uint32_t)p.y * 19349663u ^ (std::uint32_t)p.z * 83492791u) % (std::uint32_t)hashSize;
+}
+
+}
+
+void SPPMIntegrator::preprocess(const Scene& scene) {
+  PathIntegrator::preprocess(scene);
+  photonLightSampler = createLightSampler(LightSampling::Power, scene.lights);
+
+  auto radius = initialRadius > 0 ? initialRadius : scene.accel.getBounds().diag().length() / 100;
+  auto nPixels = camera.film.pixelBounds.area();
+  pixels.reset(new Pixel[nPixels]);
+  for (auto i = 0; i < nPixels; ++i)
+    pixels[i].radius = radius;
+  nIterations = 0;
+}
+
+void SPPMIntegrator::renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas) {
+
+  using Node = GridNode<Pixel>;
+
+  auto& film = camera.film;
+  auto bounds = renderBounds();
+  auto diag = bounds.diag();
+  auto nPixels = bounds.area();
+  auto nPhotons = photonsPerIteration > 0 ? photonsPerIteration : nPixels;
+
+  iterationArenas.resize(parallelThreadCount());
+  for (auto& arena : iterationArenas)
+    if (!arena) arena.reset(new MemoryArena());
+
+  for (auto sample = 0; sample < nSamples; ++sample) {
+    for (auto& arena : iterationArenas)
+      arena->reset();
+
+    // Camera paths, following specular bounces to the first surface that
+    // can gather photons and adding the light found on the way.
+    parallelFor([&](std::int64_t y) {
+      auto rowSampler = sampler.clone(streamSeed({ pass, sample, (int)Stage::Camera, bounds.pMin.y + y }));
+      RenderContext ctx(*rowSampler, *iterationArenas[parallelThreadIndex()], threadStats());
+
+      for (auto x = 0; x < diag.x; ++x) {
+        Vector2i pPixel(bounds.pMin.x + x, bounds.pMin.y + (int)y);
+        auto& pixel = pixels[film.pixelIndex(pPixel)];
+        pixel.vp = VisiblePoint();
+
+        auto cameraSample = ctx.sampler.getCameraSample(pPixel);
+        auto ray = camera.generateRay(cameraSample);
+        NANOPT_STAT_INC_TO(ctx.stats, CameraRays);
+        AOVSample aov;
+        Spectrum beta(1);
+        auto specularBounce = false;
+
+        for (auto depth = 0; depth < maxDepth; ++depth) {
+          Interaction isect;
+          if (!scene.intersect(ray, isect)) {
+            if (scene.infiniteLight) pixel.ld += beta * scene.infiniteLight->le(ray);
+            break;
+          }
+          if (depth == 0 || specularBounce)
+            pixel.ld += beta * isect.le(-ray.d);
+
+          isect.computeScatteringFunctions(ctx.arena);
+          if (depth == 0 && film.aovs) recordAOV(aov, ray, isect);
+          if (!isect.bsdf) break;
+
+          auto& bsdf = *isect.bsdf;
+          if (!bsdf.isDelta()) {
+            pixel.ld += beta * sampleOneLight(isect, scene, ctx);
+            pixel.vp = { isect.p, isect.wo, &bsdf, beta, depth };
+            break;
+          }
+
+          Vector3f wi;
+          float pdf, etaScale;
+          auto f = bsdf.sample(ctx.sampler.get2D(), isect.wo, wi, pdf, etaScale);
+          if (f.isBlack() || pdf == 0) break;
+          beta *= f * absdot(wi, isect.ns) / pdf;
+          specularBounce = true;
+          ray = isect.spawnRay(wi);
+        }
+
+        if (film.aovs) film.addAOVSample(cameraSample.pFilm, aov);
+      }
+    }, diag.y);
+
+    // Grid over the visible points with cells the size of the largest
+    // radius, hashed into as many buckets as there are pixels.
+    Bounds3f gridBounds;
+    auto maxRadius = 0.0f;
+    for (auto p : bounds) {
+      auto& pixel = pixels[film.pixelIndex(p)];
+      if (pixel.vp.beta.isBlack()) continue;
+      auto r = Vector3f(pixel.radius);
+      gridBounds.merge(Bounds3f(pixel.vp.p - r, pixel.vp.p + r));
+      maxRadius = std::max(maxRadius, pixel.radius);
+    }
+    if (maxRadius == 0) {
+      ++nIterations;
+      continue;
+    }
+
+    auto gridDiag = gridBounds.diag();
+    auto maxDiag = std::max(gridDiag.x, std::max(gridDiag.y, gridDiag.z));
+    auto baseResolution = std::max(1, (int)(maxDiag / maxRadius));
+    Vector3i gridResolution;
+    for (auto i = 0; i < 3; ++i)
+      gridResolution[i] = std::max(1, (int)(baseResolution * gridDiag[i] / maxDiag));
+    auto toCell = [&](const Vector3f& p, Vector3i& cell) {
+      auto inside = true;
+      for (auto i = 0; i < 3; ++i) {
+        auto c = gridDiag[i] > 0 ? (int)(gridResolution[i] * (p[i] - gridBounds.pMin[i]) / gridDiag[i]) : 0;
+        inside &= c >= 0 && c < gridResolution[i];
+        cell[i] = std::max(0, std::min(c, gridResolution[i] - 1));
+      }
+      return inside;
+    };
+
+    auto hashSize = nPixels;
+    std::unique_ptr<std::atomic<Node*>[]> grid(new std::atomic<Node*>[hashSize]);
+    for (auto i = 0; i < hashSize; ++i)
+      grid[i] = nullptr;
+
+    parallelFor([&](std::int64_t y) {
+      auto& arena = *iterationArenas[parallelThreadIndex()];
+      for (auto x = 0; x < diag.x; ++x) {
+        auto& pixel = pixels[film.pixelIndex(Vector2i(bounds.pMin.x + x, bounds.pMin.y + (int)y))];
+        if (pixel.vp.beta.isBlack()) continue;
+        auto r = Vector3f(pixel.radius);
+        Vector3i pMin, pMax;
+        toCell(pixel.vp.p - r, pMin);
+        toCell(pixel.vp.p + r, pMax);
+        for (auto cz = pMin.z; cz <= pMax.z; ++cz)
+          for (auto cy = pMin.y; cy <= pMax.y; ++cy)
+            for (auto cx = pMin.x; cx <= pMax.x; ++cx) {
+              auto& head = grid[hashCell(Vector3i(cx, cy, cz), hashSize)];
+              auto node = arena.create<Node>();
+              node->pixel = &pixel;
+              node->next = head.load(std::memory_order_relaxed);
+              while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+                ;
+            }
+      }
+    }, diag.y);
+
+    // Photons, each adding its flux to the visible points around every
+    // surface it reaches after leaving the light. Their first hit is
+    // direct lighting, which the camera paths already account for.
+    auto nChunks = (nPhotons + PhotonChunkSize - 1) / PhotonChunkSize;
+    parallelFor([&](std::int64_t chunk) {
+      auto chunkSampler = sampler.clone(streamSeed({ pass, sample, (int)Stage::Photons, chunk }));
+      auto& s = *chunkSampler;
+      auto& arena = *arenas[parallelThreadIndex()];
+      auto end = std::min<std::int64_t>(nPhotons, (chunk + 1) * PhotonChunkSize);
+
+      for (auto i = chunk * PhotonChunkSize; i < end; ++i) {
+        float lightPmf, pdfPos, pdfDir;
+        Interaction ref;
+        auto light = photonLightSampler->sample(ref, s.get1D(), lightPmf);
+        auto u1 = s.get2D();
+        auto u2 = s.get2D();
+        if (!light) continue;
+        Ray ray(Vector3f(0), Vector3f(0));
+        Vector3f nLight;
+        auto le = light->sampleLe(u1, u2, ray, nLight, pdfPos, pdfDir);
+        if (le.isBlack() || pdfPos == 0 || pdfDir == 0) continue;
+        auto beta = le * absdot(nLight, ray.d) / (lightPmf * pdfPos * pdfDir);
+
+        for (auto depth = 0; depth < maxDepth; ++depth) {
+          Interaction isect;
+          if (!scene.intersect(ray, isect)) break;
+
+          Vector3i cell;
+          if (depth > 0 && toCell(isect.p, cell)) {
+            for (auto node = grid[hashCell(cell, hashSize)].load(std::memory_order_acquire); node; node = node->next) {
+              auto& pixel = *node->pixel;
+              if (depth + pixel.vp.depth >= maxDepth) continue;
+              if ((pixel.vp.p - isect.p).lengthSquared() > pixel.radius * pixel.radius) continue;
+              auto phi = beta * pixel.vp.bsdf->f(pixel.vp.wo, -ray.d);
+              for (auto c = 0; c < 3; ++c)
+                pixel.phi[c].add(phi[c]);
+              pixel.m.fetch_add(1, std::memory_order_relaxed);
+            }
+          }
+
+          isect.computeScatteringFunctions(arena);
+          if (!isect.bsdf) break;
+          Vector3f wi;
+          float pdf, etaScale;
+          auto f = isect.bsdf->sample(s.get2D(), isect.wo, wi, pdf, etaScale);
+          if (f.isBlack() || pdf == 0) break;
+          // Refraction scales radiance, not the flux photons carry.
+          auto betaNew = beta * f * (absdot(wi, isect.ns) / pdf * etaScale);
+
+          // Roulette keeps photons at about the flux they started with.
+          auto q = std::max(0.0f, 1 - betaNew.maxComponent() / beta.maxComponent());
+          if (s.get1D() < q) break;
+          beta = betaNew / (1 - q);
+          ray = isect.spawnRay(wi);
+        }
+        arena.reset();
+      }
+    }, nChunks);
+
+    // Progressive update, shrinking each radius so that a fixed share of
+    // the photons gathered this iteration is kept.
+    constexpr auto Alpha = 2.0f / 3.0f;
+    for (auto p : bounds) {
+      auto& pixel = pixels[film.pixelIndex(p)];
+      auto m = pixel.m.load(std::memory_order_relaxed);
+      if (m > 0) {
+        auto n = pixel.n + Alpha * m;
+        auto radius = pixel.radius * std::sqrt(n / (pixel.n + m));
+        auto phi = Spectrum(pixel.phi[0], pixel.phi[1], pixel.phi[2]);
+        pixel.tau = (pixel.tau + pixel.vp.beta * phi) * (radius * radius) / (pixel.radius * pixel.radius);
+        pixel.n = n;
+        pixel.radius = radius;
+        pixel.m = 0;
+        for (auto& c : pixel.phi)
+          c = 0;
+      }
+      pixel.vp = VisiblePoint();
+    }
+    ++nIterations;
+  }
+
+  // The estimate replaces whatever the film held, as a single sample.
+  for (auto p : bounds) {
+    auto i = film.pixelIndex(p);
+    auto& pixel = pixels[i];
+    auto nTotal = (float)nIterations * nPhotons;
+    auto l = pixel.ld / (float)nIterations + pixel.tau / (nTotal * Pi * pixel.radius * pixel.radius);
+    auto& accum = film.accum[i];
+    accum = Film::Pixel();
+    accum.lSum = l;
+    accum.weightSum = 1;
+    accum.nSamples = nIterations;
+  }
+}
+
+}
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <nanopt/core/bsdf.h>
+#include <nanopt/core/stats.h>
+#include <nanopt/core/parallel.h>
+#include <nanopt/core/triangle.h>
+#include <nanopt/core/visibilitytester.h>
+#include <nanopt/integrators/wavefront.h>
+
+namespace nanopt {
+
+namespace {
+
+constexpr auto ChunkSize = 256;
+
+enum class Stage {
+  GenerateCameraRays,
+  SampleLightsAndBSDFs
+};
+
+// A ray produced by a shading stage, waiting to be traced. Slots are laid
+// out by queue position and compacted before tracing so that the queues
+// and with them the random streams stay deterministic.
+struct RayWork {
+  Ray ray = Ray(Vector3f(0, 0, 0), Vector3f(0, 0, 0));
+  Spectrum contribution = Spectrum(0);
+  const Light* light = nullptr;
+  int path = -1;
+};
+
+struct RayQueue {
+  void clear() {
+    rays.clear();
+    slots.clear();
+  }
+
+  void compact(const std::vector<RayWork>& work, int n) {
+    clear();
+    for (auto i = 0; i < n; ++i) {
+      if (work[i].path < 0) continue;
+      rays.push_back(work[i].ray);
+      slots.push_back(i);
+    }
+  }
+
+  int size() const {
+    return (int)rays.size();
+  }
+
+  std::vector<Ray> rays;
+  std::vector<int> slots;
+};
+
+template <typename F>
+void forEachChunk(int n, F&& func) {
+  auto nChunks = (n + ChunkSize - 1) / ChunkSize;
+  parallelFor([&](std::int64_t chunk) {
+    auto begin = (int)chunk * ChunkSize;
+    func(chunk, begin, std::min(n, begin + ChunkSize));
+  }, nChunks);
+}
+
+}
+
+void WavefrontPathIntegrator::renderPass(
+    const Scene& scene,
+    int pass, int nSamples,
+    std::vector<std::unique_ptr<MemoryArena>>& arenas) {
+
+  auto& film = camera.film;
+  auto& pixelBounds = film.pixelBounds;
+  auto diag = pixelBounds.diag();
+  auto pixelsPerBatch = std::max(1, maxQueueSize / nSamples);
+  auto maxPaths = pixelsPerBatch * nSamples;
+
+  std::vector<int> pixelList;
+  for (auto p : renderBounds())
+    if (isPixelActive(p)) pixelList.push_back(film.pixelIndex(p));
+  auto nPixels = (int)pixelList.size();
+
+  auto pixelAt = [&](int i) {
+    auto index = pixelList[i];
+    return Vector2i(pixelBounds.pMin.x + index % diag.x, pixelBounds.pMin.y + index / diag.x);
+  };
+
+  // Per path state, indexed by path.
+  std::vector<Vector2f> pFilm(maxPaths);
+  std::vector<Spectrum> l(maxPaths), beta(maxPaths);
+  std::vector<float> etaScaleFix(maxPaths);
+  std::vector<char> specularBounce(maxPaths);
+  std::vector<AOVSample> aovs(film.aovs ? maxPaths : 0);
+
+  // Per bounce state, indexed by position in the current ray queue.
+  std::vector<Ray> rays(maxPaths, Ray(Vector3f(0, 0, 0), Vector3f(0, 0, 0)));
+  std::vector<int> paths(maxPaths);
+  std::vector<Interaction> isects(maxPaths);
+  std::unique_ptr<bool[]> hits(new bool[maxPaths]);
+  std::vector<int> order;
+  std::vector<RayWork> shadowWork(maxPaths), bsdfWork(maxPaths), nextWork(maxPaths);
+
+  RayQueue shadowQueue, bsdfQueue, nextQueue;
+  std::unique_ptr<bool[]> occluded(new bool[maxPaths]);
+  std::vector<Interaction> lightIsects(maxPaths);
+
+  for (auto batch = 0; batch * pixelsPerBatch < nPixels; ++batch) {
+    auto firstPixel = batch * pixelsPerBatch;
+    auto nPaths = std::min(pixelsPerBatch, nPixels - firstPixel) * nSamples;
+
+    forEachChunk(nPaths, [&](std::int64_t chunk, int begin, int end) {
+      auto chunkSampler = sampler.clone(
+        streamSeed({ pass, batch, 0, (int)Stage::GenerateCameraRays, chunk }));
+      for (auto i = begin; i < end; ++i) {
+        auto cameraSample = chunkSampler->getCameraSample(pixelAt(firstPixel + i / nSamples));
+        pFilm[i] = cameraSample.pFilm;
+        rays[i] = camera.generateRay(cameraSample);
+        paths[i] = i;
+        l[i] = Spectrum(0);
+        beta[i] = Spectrum(1);
+        etaScaleFix[i] = 1;
+        specularBounce[i] = false;
+        if (film.aovs) aovs[i] = AOVSample();
+      }
+    });
+    NANOPT_STAT_ADD(CameraRays, nPaths);
+
+    auto nRays = nPaths;
+    for (auto bounce = 0; bounce < maxDepth && nRays > 0; ++bounce) {
+      forEachChunk(nRays, [&](std::int64_t, int begin, int end) {
+        scene.intersectStream(&rays[begin], end - begin, &isects[begin], &hits[begin]);
+      });
+
+      forEachChunk(nRays, [&](std::int64_t, int begin, int end) {
+        for (auto q = begin; q < end; ++q) {
+          auto path = paths[q];
+          if (bounce == 0 || specularBounce[path]) {
+            if (hits[q])
+              l[path] += beta[path] * isects[q].le(-rays[q].d);
+            else if (scene.infiniteLight)
+              l[path] += beta[path] * scene.infiniteLight->le(rays[q]);
+          }
+          if (!hits[q]) NANOPT_STAT_REPORT(PathLength, bounce);
+          isects[q].bsdf = nullptr;
+          shadowWork[q].path = bsdfWork[q].path = nextWork[q].path = -1;
+        }
+      });
+
+      // Shade hits grouped by material so each material's code and data
+      // stay hot while it is evaluated.
+      order.clear();
+      for (auto q = 0; q < nRays; ++q)
+        if (hits[q]) order.push_back(q);
+      std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return std::less<const Material*>()(isects[a].triangle->material, isects[b].triangle->material);
+      });
+
+      forEachChunk((int)order.size(), [&](std::int64_t, int begin, int end) {
+        auto& arena = *arenas[parallelThreadIndex()];
+        for (auto i = begin; i < end; ++i)
+          isects[order[i]].computeScatteringFunctions(arena);
+      });
+
+      forEachChunk(nRays, [&](std::int64_t chunk, int begin, int end) {
+        auto chunkSampler = sampler.clone(
+          streamSeed({ pass, batch, bounce, (int)Stage::SampleLightsAndBSDFs, chunk }));
+        auto& s = *chunkSampler;
+
+        for (auto q = begin; q < end; ++q) {
+          if (!hits[q]) continue;
+          auto& isect = isects[q];
+          auto path = paths[q];
+          if (bounce == 0 && film.aovs) recordAOV(aovs[path], rays[q], isect);
+          if (!isect.bsdf) {
+            NANOPT_STAT_REPORT(PathLength, bounce);
+            continue;
+          }
+
+          float lightPmf;
+          if (auto sampledLight = lightSampler->sample(isect, s.get1D(), lightPmf)) {
+            auto& light = *sampledLight;
+            auto scale = beta[path] / lightPmf;
+
+            Vector3f wi;
+            float lightPdf;
+            VisibilityTester tester;
+            auto li = light.sample(isect, s.get2D(), wi, lightPdf, tester);
+
+            if (!li.isBlack()) {
+              auto f = isect.bsdf->f(isect.wo, wi) * absdot(isect.ns, wi);
+              if (!f.isBlack()) {
+                auto weight = 1.0f;
+                if (!light.isDelta())
+                  weight = powerHeuristic(lightPdf, isect.bsdf->pdf(isect.wo, wi));
+                shadowWork[q] = { tester.shadowRay(), scale * f * li * weight / lightPdf, &light, path };
+              }
+
+              if (!light.isDelta() && !isect.bsdf->isDelta()) {
+                float etaScale;
+                float scatteringPdf;
+                f = isect.bsdf->sample(s.get2D(), isect.wo, wi, scatteringPdf, etaScale);
+                f *= absdot(isect.ns, wi);
+                if (!f.isBlack()) {
+                  lightPdf = light.pdf(isect, wi);
+                  if (lightPdf != 0) {
+                    auto weight = powerHeuristic(scatteringPdf, lightPdf);
+                    bsdfWork[q] = { isect.spawnRay(wi), scale * f * weight / scatteringPdf, &light, path };
+                  }
+                }
+              }
+            }
+          }
+
+          float etaScale;
+          float scatteringPdf;
+          Vector3f wi, wo = -rays[q].d;
+          auto f = isect.bsdf->sample(s.get2D(), wo, wi, scatteringPdf, etaScale);
+          if (f.isBlack()) {
+            NANOPT_STAT_REPORT(PathLength, bounce);
+            continue;
+          }
+
+          beta[path] *= f * absdot(isect.ns, wi) / scatteringPdf;
+          etaScaleFix[path] *= etaScale;
+          specularBounce[path] = isect.bsdf->isDelta();
+
+          auto rrBeta = beta[path] * etaScaleFix[path];
+          if (rrBeta.maxComponent() < 1.0f && bounce > 3) {
+            auto pTerminate = std::max(0.05f, 1 - rrBeta.maxComponent());
+            if (s.get1D() < pTerminate) {
+              NANOPT_STAT_INC(RussianRouletteTerminations);
+              NANOPT_STAT_REPORT(PathLength, bounce);
+              continue;
+            }
+            beta[path] /= 1 - pTerminate;
+          }
+
+          nextWork[q].ray = isect.spawnRay(wi);
+          nextWork[q].path = path;
+        }
+      });
+
+      for (auto& arena : arenas)
+        arena->reset();
+
+      shadowQueue.compact(shadowWork, nRays);
+      forEachChunk(shadowQueue.size(), [&](std::int64_t, int begin, int end) {
+        scene.occludedStream(&shadowQueue.rays[begin], end - begin, &occluded[begin]);
+        for (auto i = begin; i < end; ++i) {
+          if (occluded[i]) continue;
+          auto& work = shadowWork[shadowQueue.slots[i]];
+          l[work.path] += work.contribution;
+        }
+      });
+
+      bsdfQueue.compact(bsdfWork, nRays);
+      forEachChunk(bsdfQueue.size(), [&](std::int64_t, int begin, int end) {
+        scene.intersectStream(&bsdfQueue.rays[begin], end - begin, &lightIsects[begin], &hits[begin]);
+        for (auto i = begin; i < end; ++i) {
+          auto& work = bsdfWork[bsdfQueue.slots[i]];
+          auto li = Spectrum(0);
+          if (hits[i]) {
+            if ((const Light*)lightIsects[i].triangle->light == work.light)
+              li = lightIsects[i].le(-work.ray.d);
+          } else if (work.light == scene.infiniteLight) {
+            li = scene.infiniteLight->le(work.ray);
+          }
+          l[work.path] += work.contribution * li;
+        }
+      });
+
+      nextQueue.compact(nextWork, nRays);
+      nRays = nextQueue.size();
+      for (auto i = 0; i < nRays; ++i) {
+        rays[i] = nextQueue.rays[i];
+        paths[i] = nextWork[nextQueue.slots[i]].path;
+      }
+    }
+
+    for (auto i = 0; i < nRays; ++i)
+      NANOPT_STAT_REPORT(PathLength, maxDepth);
+
+    // Filtered samples overlap neighboring pixels, so they are added on
+    // this thread, which also keeps the sums independent of scheduling.
+    for (auto i = 0; i < nPaths; ++i) {
+      film.addSample(pFilm[i], l[i]);
+      if (film.aovs) film.addAOVSample(pFilm[i], aovs[i]);
+    }
+  }
+}
+
+}
@@ -0,0 +1,152 @@
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <nanopt/core/parallel.h>
+#include <nanopt/core/sampling.h>
+#include <nanopt/utils/imageio.h>
+#include <nanopt/lights/infinite.h>
+
+namespace nanopt {
+
+InfiniteAreaLight::InfiniteAreaLight(
+    const std::string& filename,
+    const Spectrum& scale,
+    const Matrix4& lightToWorld)
+  : lightToWorld(lightToWorld)
+  , worldToLight(inverse(lightToWorld)) {
+
+  lmap = readImage(filename, width, height);
+  if (width <= 0 || height <= 0)
+    throw std::runtime_error("Environment map " + filename + " is empty");
+  buildDistribution(scale);
+}
+
+InfiniteAreaLight::InfiniteAreaLight(
+    std::unique_ptr<Spectrum[]> lmap, int width, int height,
+    const Spectrum& scale,
+    const Matrix4& lightToWorld)
+  : lmap(std::move(lmap))
+  , width(width)
+  , height(height)
+  , lightToWorld(lightToWorld)
+  , worldToLight(inverse(lightToWorld)) {
+
+  buildDistribution(scale);
+}
+
+void InfiniteAreaLight::buildDistribution(const Spectrum& scale) {
+  // Rows nearer the poles cover less solid angle, sin theta at the texel
+  // centers accounting for it.
+  std::unique_ptr<float[]> func(new float[width * height]);
+  parallelFor([&](std::int64_t y) {
+    auto sinTheta = std::sin(Pi * (y + 0.5f) / height);
+    for (auto x = 0; x < width; ++x) {
+      auto& l = lmap[y * width + x];
+      l *= scale;
+      func[y * width + x] = std::max(0.0f, l.y()) * sinTheta;
+    }
+  }, height, 32);
+  distribution.reset(new Distribution2D(func.get(), width, height));
+}
+
+void InfiniteAreaLight::preprocess(const Bounds3f& sceneBounds) {
+  worldCenter = sceneBounds.centroid();
+  worldRadius = sceneBounds.diag().length() / 2;
+}
+
+Spectrum InfiniteAreaLight::power() const {
+  // Radiance integrated over the sphere, falling on a disk as large as
+  // the scene.
+  auto sum = Spectrum(0);
+  for (auto y = 0; y < height; ++y) {
+    auto sinTheta = std::sin(Pi * (y + 0.5f) / height);
+    for (auto x = 0; x < width; ++x)
+      sum += lmap[y * width + x] * sinTheta;
+  }
+  return sum * (2 * Pi * Pi / (width * height)) * Pi * worldRadius * worldRadius;
+}
+
+Vector2f InfiniteAreaLight::directionToUV(const Vector3f& w) const {
+  auto wLight = normalize(worldToLight.applyV(w));
+  auto theta = std::acos(clamp(wLight.y, -1, 1));
+  auto phi = std::atan2(wLight.z, wLight.x);
+  if (phi < 0) phi += 2 * Pi;
+  return Vector2f(phi * Inv2Pi, theta * InvPi);
+}
+
+Vector3f InfiniteAreaLight::uvToDirection(const Vector2f& uv) const {
+  auto theta = uv[1] * Pi;
+  auto phi = uv[0] * 2 * Pi;
+  auto sinTheta = std::sin(theta);
+  auto wLight = Vector3f(sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi));
+  return normalize(lightToWorld.applyV(wLight));
+}
+
+Spectrum InfiniteAreaLight::lookup(const Vector2f& uv) const {
+  auto x = std::min((int)(uv[0] * width), width - 1);
+  auto y = std::min((int)(uv[1] * height), height - 1);
+  return lmap[y * width + x];
+}
+
+float InfiniteAreaLight::directionPdf(const Vector2f& uv) const {
+  auto sinTheta = std::sin(uv[1] * Pi);
+  if (sinTheta == 0) return 0;
+  return distribution->pdf(uv) / (2 * Pi * Pi * sinTheta);
+}
+
+Spectrum InfiniteAreaLight::le(const Ray& ray) const {
+  return lookup(directionToUV(ray.d));
+}
+
+float InfiniteAreaLight::pdf(const Interaction& ref, const Vector3f& w) const {
+  return directionPdf(directionToUV(w));
+}
+
+Spectrum InfiniteAreaLight::sample(
+    const Interaction& ref,
+    const Vector2f& sample,
+    Vector3f& wi, float& pdf, VisibilityTester& tester) const {
+
+  float mapPdf;
+  auto uv = distribution->sampleContinuous(sample, mapPdf);
+  auto sinTheta = std::sin(uv[1] * Pi);
+  if (mapPdf == 0 || sinTheta == 0) {
+    pdf = 0;
+    return Spectrum(0);
+  }
+  wi = uvToDirection(uv);
+  pdf = mapPdf / (2 * Pi * Pi * sinTheta);
+  tester = VisibilityTester(ref, ref.p + wi * (2 * worldRadius));
+  return lookup(uv);
+}
+
+Spectrum InfiniteAreaLight::sampleLe(
+    const Vector2f& u1, const Vector2f& u2,
+    Ray& ray, Vector3f& nLight, float& pdfPos, float& pdfDir) const {
+
+  float mapPdf;
+  auto uv = distribution->sampleContinuous(u1, mapPdf);
+  auto sinTheta = std::sin(uv[1] * Pi);
+  if (mapPdf == 0 || sinTheta == 0 || worldRadius == 0) {
+    pdfPos = pdfDir = 0;
+    return Spectrum(0);
+  }
+
+  auto w = uvToDirection(uv);
+  Vector3f v1, v2;
+  coordinateSystem(w, v1, v2);
+  auto disk = uniformSampleDisk(u2);
+  auto pDisk = worldCenter + (v1 * disk.x + v2 * disk.y) * worldRadius;
+  ray = Ray(pDisk + w * worldRadius, -w);
+  nLight = -w;
+  pdfDir = mapPdf / (2 * Pi * Pi * sinTheta);
+  pdfPos = 1 / (Pi * worldRadius * worldRadius);
+  return lookup(uv);
+}
+
+void InfiniteAreaLight::pdfLe(const Ray& ray, const Vector3f& nLight, float& pdfPos, float& pdfDir) const {
+  pdfDir = directionPdf(directionToUV(-ray.d));
+  pdfPos = worldRadius > 0 ? 1 / (Pi * worldRadius * worldRadius) : 0;
+}
+
+}
@@ -0,0 +1,179 @@
+#include <cmath>
+#include <algorithm>
+#include <nanopt/math/math.h>
+#include <nanopt/lightsamplers/bvh.h>
+
+namespace nanopt {
+
+namespace {
+
+constexpr auto NumBuckets = 12;
+// Deeper nodes are split in halves, which keeps the bit trails within
+// 64 bits however unbalanced the splits above them are.
+constexpr auto MaxSplitDepth = 32;
+
+// Surface area heuristic extended with the solid angle the lights emit
+// into, so splits also separate lights that face different ways.
+float splitCost(const LightBounds& b, const Bounds3f& bounds, int dim) {
+  auto thetaO = std::acos(clamp(b.cosThetaO, -1, 1));
+  auto thetaE = std::acos(clamp(b.cosThetaE, -1, 1));
+  auto thetaW = std::min(thetaO + thetaE, Pi);
+  auto sinThetaO = std::sqrt(std::max(0.0f, 1 - b.cosThetaO * b.cosThetaO));
+  auto mOmega = 2 * Pi * (1 - b.cosThetaO) +
+    PiOver2 * (2 * thetaW * sinThetaO - std::cos(thetaO - 2 * thetaW) - 2 * thetaO * sinThetaO + b.cosThetaO);
+  auto d = bounds.diag();
+  auto kr = std::max(d.x, std::max(d.y, d.z)) / d[dim];
+  return b.phi * mOmega * kr * b.bounds.area();
+}
+
+}
+
+BVHLightSampler::BVHLightSampler(const std::vector<Light*>& lights) {
+  std::vector<std::pair<int, LightBounds>> bvhLights;
+  for (auto light : lights) {
+    auto lightBounds = light->bounds();
+    if (!lightBounds) {
+      infiniteLights.push_back(light);
+    } else if (lightBounds->phi > 0) {
+      bvhLights.emplace_back((int)boundedLights.size(), *lightBounds);
+      boundedLights.push_back(light);
+    }
+  }
+  if (!bvhLights.empty())
+    build(bvhLights, 0, (int)bvhLights.size(), 0, 0);
+}
+
+int BVHLightSampler::build(
+    std::vector<std::pair<int, LightBounds>>& bvhLights,
+    int begin, int end, std::uint64_t bitTrail, int depth) {
+
+  if (end - begin == 1) {
+    auto nodeIndex = (int)nodes.size();
+    nodes.push_back({ bvhLights[begin].second, bvhLights[begin].first, true });
+    lightToBitTrail[boundedLights[bvhLights[begin].first]] = bitTrail;
+    return nodeIndex;
+  }
+
+  Bounds3f bounds, centroidBounds;
+  for (auto i = begin; i < end; ++i) {
+    auto& lb = bvhLights[i].second;
+    bounds.merge(lb.bounds);
+    centroidBounds.merge(lb.bounds.centroid());
+  }
+
+  auto minCost = Infinity;
+  auto minCostSplitBucket = -1;
+  auto minCostSplitDim = -1;
+  for (auto dim = 0; dim < 3 && depth < MaxSplitDepth; ++dim) {
+    if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) continue;
+
+    LightBounds buckets[NumBuckets];
+    auto bucketOf = [&](const LightBounds& lb) {
+      auto b = (int)(NumBuckets * centroidBounds.offset(lb.bounds.centroid())[dim]);
+      return std::min(b, NumBuckets - 1);
+    };
+    for (auto i = begin; i < end; ++i) {
+      auto& lb = bvhLights[i].second;
+      auto& bucket = buckets[bucketOf(lb)];
+      bucket = merge(bucket, lb);
+    }
+
+    for (auto split = 0; split < NumBuckets - 1; ++split) {
+      LightBounds below, above;
+      for (auto i = 0; i <= split; ++i)
+        below = merge(below, buckets[i]);
+      for (auto i = split + 1; i < NumBuckets; ++i)
+        above = merge(above, buckets[i]);
+      if (below.phi == 0 || above.phi == 0) continue;
+      auto cost = splitCost(below, bounds, dim) + splitCost(above, bounds, dim);
+      if (cost < minCost) {
+        minCost = cost;
+        minCostSplitBucket = split;
+        minCostSplitDim = dim;
+      }
+    }
+  }
+
+  auto mid = begin + (end - begin) / 2;
+  if (minCostSplitDim >= 0) {
+    auto split = std::partition(bvhLights.begin() + begin, bvhLights.begin() + end,
+      [&](const std::pair<int, LightBounds>& l) {
+        auto b = (int)(NumBuckets * centroidBounds.offset(l.second.bounds.centroid())[minCostSplitDim]);
+        return std::min(b, NumBuckets - 1) <= minCostSplitBucket;
+      });
+    mid = (int)(split - bvhLights.begin());
+    if (mid == begin || mid == end)
+      mid = begin + (end - begin) / 2;
+  }
+
+  auto nodeIndex = (int)nodes.size();
+  nodes.push_back({ LightBounds(), 0, false });
+  build(bvhLights, begin, mid, bitTrail, depth + 1);
+  auto secondChild = build(bvhLights, mid, end, bitTrail | (std::uint64_t(1) << depth), depth + 1);
+
+  nodes[nodeIndex].lightBounds = merge(nodes[nodeIndex + 1].lightBounds, nodes[secondChild].lightBounds);
+  nodes[nodeIndex].childOrLightIndex = secondChild;
+  return nodeIndex;
+}
+
+const Light* BVHLightSampler::sample(const Interaction& ref, float u, float& pmf) const {
+  auto pInfinite = probabilityOfInfinite();
+  if (u < pInfinite) {
+    auto n = infiniteLights.size();
+    pmf = pInfinite / n;
+    return infiniteLights[std::min((std::size_t)(u / pInfinite * n), n - 1)];
+  }
+  if (nodes.empty()) return nullptr;
+
+  u = std::min((u - pInfinite) / (1 - pInfinite), OneMinusEpsilon);
+  pmf = 1 - pInfinite;
+  auto nodeIndex = 0;
+  while (true) {
+    auto& node = nodes[nodeIndex];
+    if (node.isLeaf) {
+      if (nodeIndex > 0 || node.lightBounds.importance(ref.p, ref.n) > 0)
+        return boundedLights[node.childOrLightIndex];
+      return nullptr;
+    }
+
+    auto importance0 = nodes[nodeIndex + 1].lightBounds.importance(ref.p, ref.n);
+    auto importance1 = nodes[node.childOrLightIndex].lightBounds.importance(ref.p, ref.n);
+    if (importance0 == 0 && importance1 == 0) return nullptr;
+
+    auto p0 = importance0 / (importance0 + importance1);
+    if (u < p0) {
+      pmf *= p0;
+      u = std::min(u / p0, OneMinusEpsilon);
+      nodeIndex = nodeIndex + 1;
+    } else {
+      pmf *= 1 - p0;
+      u = std::min((u - p0) / (1 - p0), OneMinusEpsilon);
+      nodeIndex = node.childOrLightIndex;
+    }
+  }
+}
+
+float BVHLightSampler::pmf(const Interaction& ref, const Light& light) const {
+  auto it = lightToBitTrail.find(&light);
+  if (it == lightToBitTrail.end()) {
+    auto isInfinite = std::find(infiniteLights.begin(), infiniteLights.end(), &light) != infiniteLights.end();
+    return isInfinite ? probabilityOfInfinite() / infiniteLights.size() : 0;
+  }
+
+  auto bitTrail = it->second;
+  auto pmf = 1 - probabilityOfInfinite();
+  auto nodeIndex = 0;
+  while (!nodes[nodeIndex].isLeaf) {
+    auto& node = nodes[nodeIndex];
+    auto importance0 = nodes[nodeIndex + 1].lightBounds.importance(ref.p, ref.n);
+    auto importance1 = nodes[node.childOrLightIndex].lightBounds.importance(ref.p, ref.n);
+    if (importance0 == 0 && importance1 == 0) return 0;
+    auto second = bitTrail & 1;
+    pmf *= (second ? importance1 : importance0) / (importance0 + importance1);
+    nodeIndex = second ? node.childOrLightIndex : nodeIndex + 1;
+    bitTrail >>= 1;
+  }
+  return pmf;
+}
+
+}
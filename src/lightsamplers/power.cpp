@@ -0,0 +1,23 @@
+#include <nanopt/lightsamplers/power.h>
+
+namespace nanopt {
+
+PowerLightSampler::PowerLightSampler(const std::vector<Light*>& lights)
+  : lights(lights) {
+
+  if (lights.empty()) return;
+
+  std::vector<float> power(lights.size());
+  auto total = 0.0f;
+  for (auto i = 0; i < (int)lights.size(); ++i) {
+    power[i] = std::max(0.0f, lights[i]->power().y());
+    total += power[i];
+    lightIndices[lights[i]] = i;
+  }
+  if (total == 0)
+    std::fill(power.begin(), power.end(), 1.0f);
+
+  distribution = Distribution1D(power.data(), (int)power.size());
+}
+
+}
@@ -25,8 +25,15 @@ int main() {
   AmbientOcclusionIntegrator integrator(camera, sampler, 32);
   parallelInit();
   integrator.render(scene);
-  parallelCleanup();
   film.writeImage("./ao.png");
 
+  // Bake the same occlusion into the room's uv layout for reuse elsewhere.
+  if (mesh.uv) {
+    Vector2i bakeResolution(1024, 1024);
+    auto baked = integrator.bakeTexture(mesh, scene, bakeResolution);
+    writeImage("./ao-baked.png", bakeResolution.x, bakeResolution.y, baked.get());
+  }
+  parallelCleanup();
+
   return 0;
 }
@@ -1,8 +1,15 @@
+#include <string>
 #include <nanopt/nanopt.h>
 
 using namespace nanopt;
 
-int main() {
+// Renders the Cornell box with the path tracer. --workers N splits the
+// film between N forked worker processes instead of the local thread pool.
+int main(int argc, char** argv) {
+  auto nWorkers = 0;
+  for (auto i = 1; i + 1 < argc; ++i)
+    if (std::string(argv[i]) == "--workers") nWorkers = std::stoi(argv[++i]);
+
   auto wallsMat = std::make_unique<MatteMaterial>(Spectrum(0.725, 0.71, 0.68));
   auto wallsMesh = loadMeshOBJ("../scenes/cbox/walls.obj");
   auto triangles = createTriangleMesh(wallsMesh, wallsMat.get());
@@ -54,9 +61,16 @@ int main() {
   Scene scene(accel, std::move(lights));
   RandomSampler sampler(32);
   PathIntegrator integrator(camera, sampler, 10);
-  parallelInit();
-  integrator.render(scene);
-  parallelCleanup();
+  if (nWorkers > 0) {
+    // Workers fork, so the thread pool must not be running yet.
+    DistributedOptions options;
+    options.nWorkers = nWorkers;
+    integrator.renderDistributed(scene, options);
+  } else {
+    parallelInit();
+    integrator.render(scene);
+    parallelCleanup();
+  }
   film.writeImage("./glass.png");
 
   return 0;
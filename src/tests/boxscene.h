@@ -0,0 +1,60 @@
+#pragma once
+
+#include <nanopt/nanopt.h>
+
+namespace nanopt {
+
+// Box of quads lit by a quad in its ceiling, built in code so tests
+// need no scene files. panelLight adds a one sided light standing across
+// the floor, which only the floor on one side of it sees.
+class BoxScene {
+public:
+  BoxScene(bool panelLight = false) {
+    Spectrum white(0.7f), red(0.6f, 0.05f, 0.05f), green(0.1f, 0.5f, 0.1f);
+    addQuad({ -1, -1, -1 }, { -1, -1, 1 }, { 1, -1, 1 }, { 1, -1, -1 }, white);
+    addQuad({ -1, 1, -1 }, { 1, 1, -1 }, { 1, 1, 1 }, { -1, 1, 1 }, white);
+    addQuad({ -1, -1, 1 }, { -1, 1, 1 }, { 1, 1, 1 }, { 1, -1, 1 }, white);
+    addQuad({ -1, -1, -1 }, { -1, 1, -1 }, { -1, 1, 1 }, { -1, -1, 1 }, red);
+    addQuad({ 1, -1, -1 }, { 1, -1, 1 }, { 1, 1, 1 }, { 1, 1, -1 }, green);
+
+    meshes.emplace_back(quad({ -0.3f, 0.99f, -0.3f }, { -0.3f, 0.99f, 0.3f }, { 0.3f, 0.99f, 0.3f }, { 0.3f, 0.99f, -0.3f }));
+    lightTriangles = createTriangleMesh(*meshes.back());
+    std::vector<Light*> lights;
+    for (auto& triangle : lightTriangles)
+      lights.push_back(new DiffuseAreaLight(&triangle, Spectrum(15)));
+    if (panelLight) {
+      meshes.emplace_back(quad({ 0.1f, -1, -1 }, { 0.1f, -0.7f, -1 }, { 0.1f, -0.7f, 1 }, { 0.1f, -1, 1 }));
+      panelTriangles = createTriangleMesh(*meshes.back());
+      for (auto& triangle : panelTriangles)
+        lights.push_back(new DiffuseAreaLight(&triangle, Spectrum(5)));
+      triangles.insert(triangles.end(), panelTriangles.begin(), panelTriangles.end());
+    }
+    triangles.insert(triangles.end(), lightTriangles.begin(), lightTriangles.end());
+
+    accel.reset(new BVHAccel(std::move(triangles)));
+    scene.reset(new Scene(*accel, std::move(lights)));
+  }
+
+  std::unique_ptr<Scene> scene;
+
+private:
+  static Mesh* quad(const Vector3f& a, const Vector3f& b, const Vector3f& c, const Vector3f& d) {
+    return new Mesh(ShadingMode::Flat, 4, 2, new int[6] { 0, 1, 2, 0, 2, 3 }, new Vector3f[4] { a, b, c, d }, nullptr, nullptr);
+  }
+
+  void addQuad(const Vector3f& a, const Vector3f& b, const Vector3f& c, const Vector3f& d, const Spectrum& kd) {
+    meshes.emplace_back(quad(a, b, c, d));
+    materials.emplace_back(new MatteMaterial(kd));
+    auto quadTriangles = createTriangleMesh(*meshes.back(), materials.back().get());
+    triangles.insert(triangles.end(), quadTriangles.begin(), quadTriangles.end());
+  }
+
+  std::vector<std::unique_ptr<Mesh>> meshes;
+  std::vector<std::unique_ptr<Material>> materials;
+  std::vector<Triangle> triangles;
+  std::vector<Triangle> lightTriangles;
+  std::vector<Triangle> panelTriangles;
+  std::unique_ptr<BVHAccel> accel;
+};
+
+}
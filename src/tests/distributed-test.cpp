@@ -0,0 +1,93 @@
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <nanopt/nanopt.h>
+#include "boxscene.h"
+
+using namespace nanopt;
+
+constexpr auto Resolution = 48;
+
+template <typename IntegratorType>
+std::vector<Spectrum> render(const BoxScene& box, bool distributed, bool gaussian) {
+  Film film(
+    Vector2i(Resolution, Resolution),
+    Bounds2f(Vector2f(0.0f), Vector2f(1.0f)),
+    gaussian ? std::unique_ptr<Filter>(new GaussianFilter()) : nullptr);
+  PerspectiveCamera camera(
+    Matrix4::lookAt(Vector3f(0, 0, -3.5f), Vector3f(0, 0, 0), Vector3f(0, 1, 0)),
+    film,
+    Bounds2f(Vector2f(-1, -1), Vector2f(1, 1)),
+    40
+  );
+  RandomSampler sampler(16);
+  IntegratorType integrator(camera, sampler, 5);
+  integrator.options.printStats = false;
+  integrator.options.samplesPerPass = 4;
+
+  if (distributed) {
+    DistributedOptions options;
+    options.nWorkers = 2;
+    options.threadsPerWorker = 2;
+    options.regionSize = 32;
+    integrator.renderDistributed(*box.scene, options);
+  } else {
+    parallelInit(2);
+    integrator.render(*box.scene);
+    parallelCleanup();
+  }
+  return std::vector<Spectrum>(film.pixels.get(), film.pixels.get() + Resolution * Resolution);
+}
+
+// Largest difference between the images relative to the brightest pixel.
+float maxDifference(const std::vector<Spectrum>& a, const std::vector<Spectrum>& b) {
+  auto difference = 0.0f, brightest = 0.0f;
+  for (auto i = 0; i < (int)a.size(); ++i)
+    for (auto c = 0; c < 3; ++c) {
+      difference = std::max(difference, std::abs(a[i][c] - b[i][c]));
+      brightest = std::max(brightest, std::abs(b[i][c]));
+    }
+  return brightest > 0 ? difference / brightest : difference;
+}
+
+bool check(bool condition, const char* message) {
+  if (!condition) std::cerr << "FAILED: " << message << std::endl;
+  return condition;
+}
+
+int main() {
+  BoxScene box;
+  auto ok = true;
+
+  // The same tiles take the same samples, which the box filter sums
+  // without any overlap between regions.
+  auto local = render<PathIntegrator>(box, false, false);
+  auto distributed = render<PathIntegrator>(box, true, false);
+  ok &= check(std::memcmp(local.data(), distributed.data(), sizeof(Spectrum) * local.size()) == 0, "distributed path tracing differs from a local render");
+
+  local = render<PathIntegrator>(box, false, true);
+  distributed = render<PathIntegrator>(box, true, true);
+  ok &= check(maxDifference(distributed, local) < 1e-5f, "distributed path tracing with a wide filter differs from a local render");
+
+  // Splats are the same but summed in another order.
+  local = render<LightTracingIntegrator>(box, false, false);
+  distributed = render<LightTracingIntegrator>(box, true, false);
+  ok &= check(maxDifference(distributed, local) < 1e-4f, "distributed light tracing differs from a local render");
+
+  local = render<BDPTIntegrator>(box, false, false);
+  distributed = render<BDPTIntegrator>(box, true, false);
+  ok &= check(maxDifference(distributed, local) < 1e-4f, "distributed BDPT differs from a local render");
+
+  parallelInit(2);
+  auto refused = false;
+  try {
+    render<PathIntegrator>(box, true, false);
+  } catch (const std::runtime_error&) {
+    refused = true;
+  }
+  parallelCleanup();
+  ok &= check(refused, "a distributed render forked with the thread pool running");
+
+  if (ok) std::cout << "All distributed tests passed" << std::endl;
+  return ok ? 0 : 1;
+}
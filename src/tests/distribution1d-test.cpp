@@ -0,0 +1,69 @@
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <nanopt/core/distribution1d.h>
+
+using namespace nanopt;
+
+static bool check(bool condition, const char* message) {
+  if (!condition) std::cerr << "FAILED: " << message << std::endl;
+  return condition;
+}
+
+// Evenly spaced u pick every entry in proportion to the function, and
+// never an entry the function is zero at.
+bool testProportions(const std::vector<float>& func) {
+  Distribution1D distribution(func.data(), func.size());
+  constexpr auto n = 1 << 16;
+  std::vector<int> counts(func.size());
+  auto ok = true;
+  for (auto i = 0; i < n; ++i) {
+    float p;
+    auto index = distribution.sampleDiscrete((i + 0.5f) / n, p);
+    if (!check(index >= 0 && index < (int)func.size(), "sampled index is out of range")) return false;
+    ok &= check(p == distribution.discretePdf(index), "returned pdf does not match discretePdf");
+    ++counts[index];
+  }
+  for (auto i = 0; i < (int)func.size(); ++i) {
+    auto expected = distribution.sum > 0 ? func[i] / distribution.sum : 1.0f / func.size();
+    ok &= check(std::abs(counts[i] / (float)n - expected) < 1e-3f, "entries are not picked in proportion to the function");
+  }
+  return ok;
+}
+
+// u at both ends of [0, 1] has to give a valid entry with nonzero pdf,
+// including the last entry, which is where u = 1 lands.
+bool testEnds(const std::vector<float>& func) {
+  Distribution1D distribution(func.data(), func.size());
+  auto ok = true;
+  for (auto u : { 0.0f, 1.0f }) {
+    float p;
+    auto index = distribution.sampleDiscrete(u, p);
+    if (!check(index >= 0 && index < (int)func.size(), "sampleDiscrete at the ends is out of range")) return false;
+    ok &= check(p > 0, "sampleDiscrete at the ends picks a zero probability entry");
+
+    int continuousIndex;
+    auto x = distribution.sampleContinuous(u, p, continuousIndex);
+    if (!check(continuousIndex >= 0 && continuousIndex < (int)func.size(), "sampleContinuous at the ends is out of range")) return false;
+    ok &= check(x >= 0 && x <= 1, "sampleContinuous at the ends leaves [0, 1]");
+    ok &= check(p > 0 && std::isfinite(p), "sampleContinuous at the ends has no valid pdf");
+  }
+  return ok;
+}
+
+int main() {
+  std::vector<std::vector<float>> funcs = {
+    { 1, 0, 3, 4 },
+    { 0.1f, 7, 0.3f, 0, 2, 0.01f, 5 },
+    { 1, 1, 1, 1, 1 },
+    { 2 },
+    { 0, 0, 0 },
+  };
+  auto ok = true;
+  for (auto& func : funcs) {
+    ok &= testProportions(func);
+    ok &= testEnds(func);
+  }
+  if (ok) std::cout << "All distribution1d tests passed" << std::endl;
+  return ok ? 0 : 1;
+}
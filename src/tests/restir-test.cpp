@@ -0,0 +1,66 @@
+#include <cmath>
+#include <iostream>
+#include <nanopt/nanopt.h>
+#include "boxscene.h"
+
+using namespace nanopt;
+
+constexpr auto Resolution = 32;
+
+// Average over the film of a render of box with the given integrator.
+template <typename IntegratorType, typename... Args>
+Spectrum renderMean(const BoxScene& box, int spp, Args... args) {
+  Film film(Vector2i(Resolution, Resolution));
+  PerspectiveCamera camera(
+    Matrix4::lookAt(Vector3f(0, 0, -3.5f), Vector3f(0, 0, 0), Vector3f(0, 1, 0)),
+    film,
+    Bounds2f(Vector2f(-1, -1), Vector2f(1, 1)),
+    40
+  );
+  RandomSampler sampler(spp);
+  IntegratorType integrator(camera, sampler, args...);
+  integrator.options.printStats = false;
+  integrator.options.samplesPerPass = 16;
+  integrator.render(*box.scene);
+
+  auto mean = Spectrum(0);
+  for (auto i = 0; i < Resolution * Resolution; ++i)
+    mean += film.pixels[i];
+  return mean / (float)(Resolution * Resolution);
+}
+
+bool check(bool condition, const char* message) {
+  if (!condition) std::cerr << "FAILED: " << message << std::endl;
+  return condition;
+}
+
+bool close(const Spectrum& a, const Spectrum& b, float tolerance) {
+  for (auto c = 0; c < 3; ++c)
+    if (std::abs(a[c] - b[c]) > tolerance * b[c]) return false;
+  return true;
+}
+
+int main() {
+  parallelInit();
+  // The panel light faces away from half the floor, where its samples
+  // have to drop out of the weights of merged reservoirs.
+  BoxScene box(true);
+
+  // Reuse only changes which light samples get shaded. Weighting merged
+  // reservoirs by the pixels that could have produced their sample keeps
+  // the mean that of direct lighting, which is what the path tracer finds
+  // with a single bounce.
+  auto reference = renderMean<PathIntegrator>(box, 1024, 1);
+  auto ok = true;
+  ok &= check(!reference.isBlack(), "the reference render is black");
+  ok &= check(close(renderMean<ReSTIRDirectIntegrator>(box, 256, 32, 0, 0.0f, false), reference, 0.01f),
+    "resampling without reuse is biased");
+  ok &= check(close(renderMean<ReSTIRDirectIntegrator>(box, 256, 32, 0, 0.0f, true), reference, 0.01f),
+    "temporal reuse is biased");
+  ok &= check(close(renderMean<ReSTIRDirectIntegrator>(box, 256), reference, 0.01f),
+    "spatiotemporal reuse is biased");
+
+  parallelCleanup();
+  if (ok) std::cout << "All ReSTIR tests passed" << std::endl;
+  return ok ? 0 : 1;
+}
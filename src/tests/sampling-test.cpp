@@ -0,0 +1,75 @@
+#include <cmath>
+#include <random>
+#include <iostream>
+#include <nanopt/core/bsdf.h>
+#include <nanopt/core/sampling.h>
+#include <nanopt/bxdfs/diffuse.h>
+#include <nanopt/bxdfs/mirror.h>
+
+using namespace nanopt;
+
+static bool check(bool condition, const char* message) {
+  if (!condition) std::cerr << "FAILED: " << message << std::endl;
+  return condition;
+}
+
+// Directions from jittered strata of the unit square have to be unit
+// length, lie above the surface and follow pdf = cos theta / pi, under
+// which cos^2 theta and phi are uniformly distributed.
+bool testCosineSampleHemisphere() {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> jitter(0, 1);
+  constexpr auto n = 256;
+  constexpr auto nBins = 8;
+  int cosBins[nBins] = { };
+  int phiBins[nBins] = { };
+  auto ok = true;
+  for (auto y = 0; y < n; ++y) {
+    for (auto x = 0; x < n; ++x) {
+      auto w = consineSampleHemisphere(Vector2f((x + jitter(rng)) / n, (y + jitter(rng)) / n));
+      ok &= check(std::abs(w.length() - 1) < 1e-5f, "cosine sampled direction is not unit length");
+      ok &= check(w.z >= 0, "cosine sampled direction is below the surface");
+      if (!ok) return false;
+
+      auto phi = std::atan2(w.y, w.x);
+      if (phi < 0) phi += 2 * Pi;
+      ++cosBins[std::min((int)(w.z * w.z * nBins), nBins - 1)];
+      ++phiBins[std::min((int)(phi * Inv2Pi * nBins), nBins - 1)];
+    }
+  }
+  for (auto i = 0; i < nBins; ++i) {
+    ok &= check(std::abs(cosBins[i] * nBins / (float)(n * n) - 1) < 0.02f, "cos theta does not follow the pdf");
+    ok &= check(std::abs(phiBins[i] * nBins / (float)(n * n) - 1) < 0.02f, "phi does not follow the pdf");
+  }
+  return ok;
+}
+
+// A diffuse lobe and a mirror lobe are picked half of the time each.
+bool testBSDFLobeSelection() {
+  Interaction isect;
+  isect.ns = Vector3f(0, 0, 1);
+  BSDF bsdf(isect);
+  Diffuse diffuse(Spectrum(0.5f));
+  Mirror mirror(Spectrum(1));
+  bsdf.add(&diffuse);
+  bsdf.add(&mirror);
+
+  constexpr auto n = 1024;
+  auto wo = normalize(Vector3f(0.3f, 0.2f, 1));
+  auto mirrored = Vector3f(-wo.x, -wo.y, wo.z);
+  auto nMirror = 0;
+  for (auto i = 0; i < n; ++i) {
+    Vector3f wi;
+    float pdf, etaScale;
+    bsdf.sample(Vector2f((i + 0.5f) / n, 0.37f), wo, wi, pdf, etaScale);
+    if ((wi - mirrored).length() < 1e-5f) ++nMirror;
+  }
+  return check(nMirror == n / 2, "lobes are not picked evenly");
+}
+
+int main() {
+  auto ok = testCosineSampleHemisphere();
+  ok &= testBSDFLobeSelection();
+  if (ok) std::cout << "All sampling tests passed" << std::endl;
+  return ok ? 0 : 1;
+}
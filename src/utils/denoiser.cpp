@@ -0,0 +1,146 @@
+#include <cmath>
+#include <vector>
+#include <stdexcept>
+#include <nanopt/core/parallel.h>
+#include <nanopt/utils/denoiser.h>
+
+namespace nanopt {
+
+namespace {
+
+constexpr auto Epsilon = 0.001f;
+constexpr auto MissDepth = 1e10f;
+
+// Demodulated lighting and its variance as separate planes, so the filter
+// streams through contiguous rows of floats.
+struct LightingPlanes {
+  explicit LightingPlanes(int n) : rgb { std::vector<float>(n), std::vector<float>(n), std::vector<float>(n) }, variance(n)
+  { }
+
+  std::vector<float> rgb[3];
+  std::vector<float> variance;
+};
+
+float luminance(float r, float g, float b) {
+  return r * 0.212671f + g * 0.715160f + b * 0.072169f;
+}
+
+}
+
+void denoise(Film& film, const DenoiserOptions& options) {
+  if (!film.aovs)
+    throw std::runtime_error("Denoiser needs a film rendered with AOVs enabled.");
+
+  auto diag = film.pixelBounds.diag();
+  auto width = diag.x;
+  auto height = diag.y;
+  auto nPixels = width * height;
+
+  std::vector<float> albedo[3], normal[3], depth(nPixels);
+  for (auto c = 0; c < 3; ++c) {
+    albedo[c].resize(nPixels);
+    normal[c].resize(nPixels);
+  }
+  LightingPlanes current(nPixels), next(nPixels);
+
+  for (auto i = 0; i < nPixels; ++i) {
+    auto& aov = film.aovs[i];
+    auto a = aov.nSamples ? aov.albedoSum / (float)aov.nSamples : Spectrum(0);
+    auto n = aov.nHits ? aov.normalSum / (float)aov.nHits : Vector3f(0, 0, 0);
+    depth[i] = aov.nHits ? aov.depthSum / aov.nHits : MissDepth;
+    for (auto c = 0; c < 3; ++c) {
+      albedo[c][i] = a[c];
+      normal[c][i] = n[c];
+      current.rgb[c][i] = film.pixels[i][c] / (a[c] + Epsilon);
+    }
+
+    // Variance of the pixel mean, carried over to the demodulated lighting.
+    auto& pixel = film.accum[i];
+    auto variance = 0.0;
+    if (pixel.nSamples > 1) {
+      auto mean = pixel.ySum / pixel.nSamples;
+      variance = std::max(0.0, (pixel.ySquaredSum - pixel.ySum * mean) / (pixel.nSamples - 1)) / pixel.nSamples;
+    }
+    auto ay = a.y() + Epsilon;
+    current.variance[i] = (float)variance / (ay * ay);
+  }
+
+  const float h[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+  auto invSigmaNormal2 = 1 / (options.sigmaNormal * options.sigmaNormal);
+  auto invSigmaAlbedo2 = 1 / (options.sigmaAlbedo * options.sigmaAlbedo);
+
+  for (auto iteration = 0; iteration < options.iterations; ++iteration) {
+    auto step = 1 << iteration;
+
+    parallelFor([&](std::int64_t y) {
+      std::vector<float> sumW(width), sumW2Var(width), sum[3] = {
+        std::vector<float>(width), std::vector<float>(width), std::vector<float>(width) };
+      std::vector<float> lumP(width), lumScale(width);
+
+      auto row = (int)y * width;
+      for (auto x = 0; x < width; ++x) {
+        auto p = row + x;
+        lumP[x] = luminance(current.rgb[0][p], current.rgb[1][p], current.rgb[2][p]);
+        lumScale[x] = 1 / (options.sigmaLuminance * std::sqrt(current.variance[p]) + Epsilon);
+      }
+
+      for (auto dy = -2; dy <= 2; ++dy) {
+        auto qy = (int)y + dy * step;
+        if (qy < 0 || qy >= height) continue;
+
+        for (auto dx = -2; dx <= 2; ++dx) {
+          auto offset = dx * step;
+          auto x0 = std::max(0, -offset);
+          auto x1 = std::min(width, width - offset);
+          auto weight = h[dy + 2] * h[dx + 2];
+          auto depthScale = 1 / (options.sigmaDepth * step);
+
+          // Branch free over a contiguous range of x, so it vectorizes.
+          auto q0 = qy * width + offset;
+          for (auto x = x0; x < x1; ++x) {
+            auto p = row + x;
+            auto q = q0 + x;
+            auto r = current.rgb[0][q], g = current.rgb[1][q], b = current.rgb[2][q];
+
+            auto dl = std::abs(lumP[x] - luminance(r, g, b)) * lumScale[x];
+            auto dn0 = normal[0][p] - normal[0][q];
+            auto dn1 = normal[1][p] - normal[1][q];
+            auto dn2 = normal[2][p] - normal[2][q];
+            auto da0 = albedo[0][p] - albedo[0][q];
+            auto da1 = albedo[1][p] - albedo[1][q];
+            auto da2 = albedo[2][p] - albedo[2][q];
+            auto dz = std::abs(depth[p] - depth[q]) * depthScale / std::min(depth[p], depth[q]);
+
+            auto w = weight * std::exp(
+              -dl -
+              (dn0 * dn0 + dn1 * dn1 + dn2 * dn2) * invSigmaNormal2 -
+              (da0 * da0 + da1 * da1 + da2 * da2) * invSigmaAlbedo2 -
+              dz);
+
+            sumW[x] += w;
+            sumW2Var[x] += w * w * current.variance[q];
+            sum[0][x] += w * r;
+            sum[1][x] += w * g;
+            sum[2][x] += w * b;
+          }
+        }
+      }
+
+      for (auto x = 0; x < width; ++x) {
+        auto p = row + x;
+        for (auto c = 0; c < 3; ++c)
+          next.rgb[c][p] = sum[c][x] / sumW[x];
+        next.variance[p] = sumW2Var[x] / (sumW[x] * sumW[x]);
+      }
+    }, height);
+
+    std::swap(current, next);
+  }
+
+  for (auto i = 0; i < nPixels; ++i) {
+    for (auto c = 0; c < 3; ++c)
+      film.pixels[i][c] = current.rgb[c][i] * (albedo[c][i] + Epsilon);
+  }
+}
+
+}
@@ -1,6 +1,8 @@
 #define TINYEXR_IMPLEMENTATION
 
+#include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <tinyexr.h>
 #include <lodepng/lodepng.h>
 #include <nanopt/utils/imageio.h>
@@ -41,7 +43,7 @@ static Spectrum* readImageEXR(const std::string& filename, int& width, int& heig
   auto data = new Spectrum[nPixels];
   for (auto i = 0; i < nPixels; ++i)
     data[i] = { rgba[i * 4 + 0], rgba[i * 4 + 1], rgba[i * 4 + 2] };
-  delete rgba;
+  free(rgba);
   return data;
 }
 
@@ -69,55 +71,79 @@ static void writeImagePNG(const std::string& filename, int width, int height, Sp
   lodepng::encode(filename, bytes.get(), width, height, LCT_RGB);
 }
 
-static void writeImageEXR(const std::string& filename, int width, int height, Spectrum* data) {
-  EXRImage image;
-  InitEXRImage(&image);
+void writeImageEXR(
+    const std::string& filename,
+    int width, int height,
+    std::vector<ImageChannel> channels) {
 
-  image.num_channels = 3;
+  // Readers expect the channel list sorted by name.
+  std::sort(channels.begin(), channels.end(), [](const ImageChannel& a, const ImageChannel& b) {
+    return a.name < b.name;
+  });
 
-  auto nPixels = width * height;
-  std::vector<float> images[3];
-  images[0].resize(nPixels);
-  images[1].resize(nPixels);
-  images[2].resize(nPixels);
-
-  for (auto i = 0; i < nPixels; ++i) {
-    images[0][i] = data[i].e[0];
-    images[1][i] = data[i].e[1];
-    images[2][i] = data[i].e[2];
-  }
+  EXRImage image;
+  InitEXRImage(&image);
 
-  float* imagePtr[3];
-  imagePtr[0] = &(images[2].at(0)); // B
-  imagePtr[1] = &(images[1].at(0)); // G
-  imagePtr[2] = &(images[0].at(0)); // R
+  auto nChannels = (int)channels.size();
+  std::vector<unsigned char*> imagePtr(nChannels);
+  for (auto i = 0; i < nChannels; ++i)
+    imagePtr[i] = (unsigned char*)channels[i].data;
 
-  image.images = (unsigned char**)imagePtr;
+  image.num_channels = nChannels;
+  image.images = imagePtr.data();
   image.width = width;
   image.height = height;
 
   EXRHeader header;
   InitEXRHeader(&header);
-  header.num_channels = 3;
+  header.num_channels = nChannels;
   header.channels = (EXRChannelInfo*)malloc(sizeof(EXRChannelInfo) * header.num_channels);
-  strcpy(header.channels[0].name, "B");
-  strcpy(header.channels[1].name, "G");
-  strcpy(header.channels[2].name, "R");
   header.pixel_types = (int*)malloc(sizeof(int) * header.num_channels);
   header.requested_pixel_types = (int*)malloc(sizeof(int) * header.num_channels);
   for (auto i = 0; i < header.num_channels; ++i) {
-    header.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
-    header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF;
+    strncpy(header.channels[i].name, channels[i].name.c_str(), 255);
+    header.channels[i].name[255] = '\0';
+    switch (channels[i].type) {
+      case ChannelType::Half:
+        header.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
+        header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF;
+        break;
+      case ChannelType::Float:
+        header.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
+        header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
+        break;
+      case ChannelType::Uint:
+        header.pixel_types[i] = TINYEXR_PIXELTYPE_UINT;
+        header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_UINT;
+        break;
+    }
   }
 
   const char* err;
   auto ret = SaveEXRImageToFile(&image, &header, filename.c_str(), &err);
-  if (ret != TINYEXR_SUCCESS)
-    throw std::runtime_error("save exr to" + filename + " failed.");
 
   free(header.channels);
   free(header.pixel_types);
   free(header.requested_pixel_types);
+
+  if (ret != TINYEXR_SUCCESS)
+    throw std::runtime_error("save exr to" + filename + " failed.");
+}
+
+static void writeImageEXR(const std::string& filename, int width, int height, Spectrum* data) {
+  auto nPixels = width * height;
+  std::vector<float> images[3];
+  for (auto c = 0; c < 3; ++c) {
+    images[c].resize(nPixels);
+    for (auto i = 0; i < nPixels; ++i)
+      images[c][i] = data[i].e[c];
+  }
+
+  writeImageEXR(filename, width, height, {
+    { "R", ChannelType::Half, images[0].data() },
+    { "G", ChannelType::Half, images[1].data() },
+    { "B", ChannelType::Half, images[2].data() }
+  });
 }
 
 void writeImage(const std::string& filename, int width, int height, Spectrum* data) {
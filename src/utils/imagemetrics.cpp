@@ -0,0 +1,100 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <nanopt/math/math.h>
+#include <nanopt/utils/imagemetrics.h>
+
+namespace nanopt {
+
+namespace {
+
+// Separable Gaussian blur with clamped borders.
+std::vector<float> blur(const std::vector<float>& in, int width, int height) {
+  constexpr auto radius = 5;
+  constexpr auto sigma = 1.5f;
+  float weights[2 * radius + 1];
+  auto sum = 0.0f;
+  for (auto i = -radius; i <= radius; ++i)
+    sum += weights[i + radius] = std::exp(-i * i / (2 * sigma * sigma));
+  for (auto& w : weights)
+    w /= sum;
+
+  std::vector<float> tmp(in.size()), out(in.size());
+  for (auto y = 0; y < height; ++y)
+    for (auto x = 0; x < width; ++x) {
+      auto v = 0.0f;
+      for (auto i = -radius; i <= radius; ++i)
+        v += weights[i + radius] * in[y * width + std::clamp(x + i, 0, width - 1)];
+      tmp[y * width + x] = v;
+    }
+  for (auto y = 0; y < height; ++y)
+    for (auto x = 0; x < width; ++x) {
+      auto v = 0.0f;
+      for (auto i = -radius; i <= radius; ++i)
+        v += weights[i + radius] * tmp[std::clamp(y + i, 0, height - 1) * width + x];
+      out[y * width + x] = v;
+    }
+  return out;
+}
+
+}
+
+double meanSquaredError(const Spectrum* image, const Spectrum* reference, int width, int height) {
+  auto n = width * height;
+  auto sum = 0.0;
+  for (auto i = 0; i < n; ++i)
+    for (auto c = 0; c < 3; ++c) {
+      double d = image[i][c] - reference[i][c];
+      sum += d * d;
+    }
+  return sum / (3.0 * n);
+}
+
+double relativeMeanSquaredError(
+    const Spectrum* image, const Spectrum* reference,
+    int width, int height, float epsilon) {
+
+  auto n = width * height;
+  auto sum = 0.0;
+  for (auto i = 0; i < n; ++i)
+    for (auto c = 0; c < 3; ++c) {
+      double d = image[i][c] - reference[i][c];
+      sum += d * d / ((double)reference[i][c] * reference[i][c] + epsilon);
+    }
+  return sum / (3.0 * n);
+}
+
+double structuralSimilarity(const Spectrum* image, const Spectrum* reference, int width, int height) {
+  constexpr auto c1 = 0.01f * 0.01f;
+  constexpr auto c2 = 0.03f * 0.03f;
+  auto n = width * height;
+  auto encode = [](const Spectrum& s) {
+    return std::pow(clamp(s.y(), 0, 1), 1 / 2.2f);
+  };
+
+  std::vector<float> a(n), b(n), aa(n), bb(n), ab(n);
+  for (auto i = 0; i < n; ++i) {
+    a[i] = encode(image[i]);
+    b[i] = encode(reference[i]);
+    aa[i] = a[i] * a[i];
+    bb[i] = b[i] * b[i];
+    ab[i] = a[i] * b[i];
+  }
+  auto muA = blur(a, width, height);
+  auto muB = blur(b, width, height);
+  auto sigmaAA = blur(aa, width, height);
+  auto sigmaBB = blur(bb, width, height);
+  auto sigmaAB = blur(ab, width, height);
+
+  auto sum = 0.0;
+  for (auto i = 0; i < n; ++i) {
+    auto varA = sigmaAA[i] - muA[i] * muA[i];
+    auto varB = sigmaBB[i] - muB[i] * muB[i];
+    auto covariance = sigmaAB[i] - muA[i] * muB[i];
+    sum += (2 * muA[i] * muB[i] + c1) * (2 * covariance + c2) /
+      ((muA[i] * muA[i] + muB[i] * muB[i] + c1) * (varA + varB + c2));
+  }
+  return sum / n;
+}
+
+}